@@ -19,6 +19,8 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    block_sector_t last_read;           /* Sector read most recently. */
+    unsigned long long read_seek;       /* Sum of distances between reads. */
   };
 
 /* List of all block devices. */
@@ -123,6 +125,10 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
   check_sector (block, sector);
   block->ops->read (block->aux, sector, buffer);
   block->read_cnt++;
+  block->read_seek += (sector > block->last_read
+                       ? sector - block->last_read
+                       : block->last_read - sector);
+  block->last_read = sector;
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -160,6 +166,29 @@ block_type (struct block *block)
   return block->type;
 }
 
+/* Returns the number of sectors read from BLOCK. */
+unsigned long long
+block_read_cnt (struct block *block)
+{
+  return block->read_cnt;
+}
+
+/* Returns the number of sectors written to BLOCK. */
+unsigned long long
+block_write_cnt (struct block *block)
+{
+  return block->write_cnt;
+}
+
+/* Returns the total distance, in sectors, between each sector
+   read from BLOCK and the one read before it.  Divided by the
+   number of reads, this is the average seek. */
+unsigned long long
+block_read_seek (struct block *block)
+{
+  return block->read_seek;
+}
+
 /* Prints statistics for each block device used for a Pintos role. */
 void
 block_print_stats (void)
@@ -171,9 +200,12 @@ block_print_stats (void)
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
-          printf ("%s (%s): %llu reads, %llu writes\n",
+          printf ("%s (%s): %llu reads, %llu writes, "
+                  "%llu sectors average read seek\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  block->read_cnt, block->write_cnt,
+                  (block->read_cnt > 0
+                   ? block->read_seek / block->read_cnt : 0));
         }
     }
 }
@@ -200,6 +232,8 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->last_read = 0;
+  block->read_seek = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -1,149 +1,643 @@
 #include "filesys/cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "filesys.h"
 
 /* Define some macros. */
-#define CACHE_ENTRY_NUM 64        		/* Number of entry in cache. */
+#define CACHE_MIN_ENTRY 16              /* Fewest entries in cache. */
 #define WRITE_BACK_FREQ 10      		/* Frequency of write back. */
+#define READ_AHEAD_MAX 64               /* Most queued read ahead. */
+#define FLUSH_BATCH_MIN 32              /* Batch when malloc fails. */
+#define CACHE_META_PERCENT 25           /* Default metadata share. */
+#define DIRTY_HIGH_PERCENT 50           /* Dirty share waking cleaner. */
+#define DIRTY_LOW_PERCENT 25            /* Dirty share it cleans to. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Number of entries requested for the cache, set by the
+   "-cache=N" kernel command-line option. */
+size_t cache_capacity = CACHE_ENTRY_NUM;
+
+/* Name of the replacement policy, set by the
+   "-cache-policy=NAME" kernel command-line option. */
+const char *cache_policy_name = "2q";
+
+/* Percentage of the cache protected for metadata, set by
+   the "-cache-meta=PERCENT" kernel command-line option. */
+int cache_meta_percent = CACHE_META_PERCENT;
 
 /* Tools for synchronization. */
 static struct lock cache_lock;          /* Lock for whole cache. */
 static struct list read_ahead_queue;    /* Queue for read ahead. */
 static struct lock ahead_lock;  	    /* Lock for read ahead. */
 static struct condition ahead_cond;     /* Condition for read_ahead. */
+static size_t ahead_cnt;                /* Length of read_ahead_queue. */
+
+/* Cache body. The data buffers live in pages taken from the
+   kernel pool, the entries themselves come from malloc(). */
+static struct cache_entry *cache;       /* Array of the cache. */
+static size_t cache_cnt;                /* Number of entries. */
+static struct list free_entries;        /* Entries never used yet. */
+
+/* Metadata entries are not picked as victims while they
+   hold no more than meta_max entries, unless nothing else
+   can be evicted. Protected by cache_lock. */
+static size_t meta_cnt;                 /* Valid metadata entries. */
+static size_t meta_max;                 /* Protected share. */
+
+/* How choosy a search for a victim is, from most to
+   least. */
+enum victim_pass {
+    PASS_CLEAN,                         /* Clean and unprotected. */
+    PASS_UNPROTECTED,                   /* Unprotected. */
+    PASS_ANY                            /* Any entry. */
+};
+
+/* A replacement policy. Its functions are called with
+   cache_lock held. */
+struct cache_policy {
+    const char *name;                   /* Name for -cache-policy. */
+    void (*init)(void);                 /* Set up the policy. */
+    /* Pick a victim among the valid entries that PASS
+       allows, lock it exclusively and forget it. NULL if
+       none can be taken. */
+    struct cache_entry *(*victim)(enum victim_pass pass);
+    void (*insert)(struct cache_entry *);   /* Entry was brought in. */
+    void (*touch)(struct cache_entry *);    /* Entry was hit. */
+};
+
+static const struct cache_policy *policy;   /* Policy in use. */
+
+/* Clock policy. */
+static size_t clock_hand;               /* Next entry to check. */
+
+/* 2Q policy. New sectors enter a1in_queue, which is FIFO.
+   Sectors evicted from there are remembered in the ghost
+   queue a1out; coming back while remembered shows they are
+   reused, so they enter am_queue, which is LRU. A scan thus
+   only churns a1in_queue. Most recent entries are at the
+   front of each queue. */
+static struct list a1in_queue;          /* First touched entries. */
+static struct list am_queue;            /* Reused entries. */
+static size_t a1in_cnt;                 /* Length of a1in_queue. */
+static size_t a1in_max;                 /* Target length of a1in. */
+
+/* Sector number remembered in the a1out ghost queue. */
+struct cache_ghost {
+    block_sector_t sector;              /* Sector evicted from a1in. */
+    struct list_elem hash_elem;         /* Elem in ghost_index. */
+    struct list_elem elem;              /* Elem in a1out or free. */
+};
+
+static struct cache_ghost *ghosts;      /* Array of the ghosts. */
+static struct list a1out_queue;         /* Ghosts, newest first. */
+static struct list free_ghosts;         /* Ghosts not in use. */
+static struct list *ghost_index;        /* Buckets by sector. */
+
+/* Index from sector number to cache entry. Each bucket is a list
+   of valid entries chained through hash_elem. Protected by
+   cache_lock. */
+static struct list *cache_index;        /* Array of buckets. */
+static size_t bucket_cnt;               /* Number of buckets. */
 
-/* Cache body. */
-static struct cache_entry cache[CACHE_ENTRY_NUM];   /* Array of the cache. */
+/* Entries whose previous, dirty sector is being written back
+   after eviction, without cache_lock held. The old sector is
+   no longer in the index, so a miss on it waits on evict_cond
+   until the write is done rather than read stale data from
+   the disk. Protected by cache_lock. */
+static struct list evicting_list;       /* Entries writing back. */
+static struct condition evict_cond;     /* A write back is done. */
+
+/* Dirty entries, in the order they became dirty. An entry
+   is in the list exactly when its dirty flag is set; both
+   change only with dirty_lock and the entry lock held. */
+static struct list dirty_list;          /* List of dirty entries. */
+static struct lock dirty_lock;          /* Lock for dirty_list. */
+static size_t dirty_cnt;                /* Length of dirty_list. */
+
+/* The cleaner thread writes back the oldest dirty entries
+   when more than dirty_high are dirty, down to dirty_low,
+   so eviction finds clean victims. It is also woken when
+   eviction finds none. Protected by dirty_lock. */
+static struct condition clean_cond;     /* Wakes the cleaner. */
+static size_t dirty_high;               /* High-water mark. */
+static size_t dirty_low;                /* Low-water mark. */
+static bool clean_wanted;               /* Eviction found no clean. */
+
+/* A dirty entry picked for a write back batch. */
+struct dirty_sector {
+    struct cache_entry *entry;          /* The entry. */
+    block_sector_t sector;              /* Its sector when picked. */
+};
+
+/* Statistics of the index, protected by cache_lock. */
+static long long lookup_cnt;            /* Number of lookups. */
+static long long probe_cnt;             /* Entries compared in lookups. */
+
+/* Statistics of the replacement, protected by cache_lock. */
+static long long hit_cnt;               /* Sectors found cached. */
+static long long miss_cnt;              /* Sectors read on demand. */
+static long long evict_cnt;             /* Entries evicted. */
+static long long dirty_evict_cnt;       /* Of those, written back. */
+
+/* Statistics of write back, protected by dirty_lock. */
+static long long flush_cnt;             /* Passes with work. */
+static long long flush_sector_cnt;      /* Sectors they wrote. */
+static long long clean_cnt;             /* Runs of the cleaner. */
+
+/* Statistics of read ahead, protected by cache_lock. */
+static long long ahead_read_cnt;        /* Sectors brought in early. */
+static long long ahead_hit_cnt;         /* Of those, later used. */
+static long long ahead_waste_cnt;       /* Of those, evicted unused. */
 
 /* Static function for operation. */
+static struct list * cache_bucket(block_sector_t sector);
 struct cache_entry * cache_find_sector(block_sector_t sector);
-struct cache_entry * cache_get_sector(block_sector_t sector);
+static struct cache_entry * cache_install(block_sector_t sector,
+                                          enum cache_type type);
+static void          cache_fill(struct cache_entry *entry, bool read);
+static bool          cache_evicting(block_sector_t sector);
+static struct cache_entry * cache_acquire(block_sector_t sector,
+                                          enum cache_type type,
+                                          bool exclusive, bool read);
+static void          cache_unlock(struct cache_entry *entry);
+static void          cache_note_hit(struct cache_entry *entry,
+                                    enum cache_type type);
+static void          cache_set_type(struct cache_entry *entry,
+                                    enum cache_type type);
+static bool          cache_skip(struct cache_entry *entry,
+                                enum victim_pass pass);
+static void          cache_prefetch(block_sector_t sector,
+                                    enum cache_type type);
+static void          cache_mark_dirty(struct cache_entry *entry);
+static void          cache_mark_clean(struct cache_entry *entry);
+static int           dirty_sector_cmp(const void *a_, const void *b_);
+static int           sector_cmp(const void *a_, const void *b_);
 struct cache_entry * cache_evict(void);
+static void                 clock_init(void);
+static struct cache_entry * clock_victim(enum victim_pass pass);
+static void                 clock_insert(struct cache_entry *entry);
+static void                 clock_touch(struct cache_entry *entry);
+static void                 twoq_init(void);
+static struct cache_entry * twoq_victim(enum victim_pass pass);
+static void                 twoq_insert(struct cache_entry *entry);
+static void                 twoq_touch(struct cache_entry *entry);
+static struct cache_entry * queue_victim(struct list *queue,
+                                         enum victim_pass pass);
+static void                 ghost_add(block_sector_t sector);
+static bool                 ghost_remove(block_sector_t sector);
+
+/* Replacement policies to choose from. */
+static const struct cache_policy policies[] = {
+    {"2q", twoq_init, twoq_victim, twoq_insert, twoq_touch},
+    {"clock", clock_init, clock_victim, clock_insert, clock_touch},
+};
 void                 cache_write_back_func(void *aux UNUSED);
+static void          cache_clean_func(void *aux UNUSED);
+static void          cache_flush(size_t target);
 void                 cache_read_ahead(void *aux UNUSED);
 void                 thread_entry_write_back (void *);
 
 
-/* Initialize the buffer cache. Including the
-   lock, list and conditional variable. */
+/* Initialize the buffer cache. Including the buffers,
+   the lock, list and conditional variable. */
 void
 cache_init(void){
-    int i = 0;
+    size_t i = 0;
+    size_t page_cnt;
+    uint8_t *buffers;
+    /* Find the replacement policy. */
+    for (i = 0; i < sizeof policies / sizeof *policies; i++)
+        if (!strcmp(cache_policy_name, policies[i].name))
+            policy = &policies[i];
+    if (policy == NULL)
+        PANIC("unknown cache policy `%s'", cache_policy_name);
+    i = 0;
+    if (cache_capacity < CACHE_MIN_ENTRY)
+        cache_capacity = CACHE_MIN_ENTRY;
+    /* Take the buffers from the kernel pool, settle for
+       fewer if that many pages are not available. */
+    page_cnt = DIV_ROUND_UP(cache_capacity, SECTORS_PER_PAGE);
+    buffers = palloc_get_multiple(0, page_cnt);
+    while (buffers == NULL && page_cnt > 1){
+        page_cnt /= 2;
+        buffers = palloc_get_multiple(0, page_cnt);
+    }
+    if (buffers == NULL)
+        PANIC("can't allocate buffer cache");
+    cache_cnt = page_cnt * SECTORS_PER_PAGE;
+    if (cache_cnt > cache_capacity)
+        cache_cnt = cache_capacity;
+    else if (cache_cnt < cache_capacity)
+        printf("cache: only %zu of %zu sectors available\n",
+               cache_cnt, cache_capacity);
+    cache = malloc(cache_cnt * sizeof *cache);
+    /* The index has a power of 2 buckets, about one per entry. */
+    bucket_cnt = 1;
+    while (bucket_cnt < cache_cnt)
+        bucket_cnt *= 2;
+    cache_index = malloc(bucket_cnt * sizeof *cache_index);
+    if (cache == NULL || cache_index == NULL)
+        PANIC("can't allocate buffer cache");
     /* Initialize lock for each entry. */
-    while (i < CACHE_ENTRY_NUM){
-        lock_init(&cache[i].entry_lock);
+    list_init(&free_entries);
+    while (i < cache_cnt){
+        cache[i].data = (char *) buffers + i * BLOCK_SECTOR_SIZE;
+        rw_lock_init(&cache[i].entry_lock);
         cache[i].valid = false;
+        cache[i].write_back = false;
+        cache[i].dirty = false;
+        cache[i].accessed = false;
+        cache[i].read_ahead = false;
+        cache[i].queue = CACHE_FREE;
+        cache[i].type = CACHE_DATA;
+        list_push_back(&free_entries, &cache[i].queue_elem);
 		i++;
     }
+    /* Initialize the sector index. */
+    for (i = 0; i < bucket_cnt; i++)
+        list_init(&cache_index[i]);
+    policy->init();
+    /* Set the metadata share. */
+    if (cache_meta_percent < 0)
+        cache_meta_percent = 0;
+    else if (cache_meta_percent > 100)
+        cache_meta_percent = 100;
+    meta_cnt = 0;
+    meta_max = cache_cnt * cache_meta_percent / 100;
     /* Initialize other tools. */
     cond_init(&ahead_cond);
     lock_init(&cache_lock);
+    list_init(&evicting_list);
+    cond_init(&evict_cond);
     lock_init(&ahead_lock);
     list_init(&read_ahead_queue);
-    /* Create thread for write back and read ahead. */
+    lock_init(&dirty_lock);
+    list_init(&dirty_list);
+    cond_init(&clean_cond);
+    dirty_high = cache_cnt * DIRTY_HIGH_PERCENT / 100;
+    dirty_low = cache_cnt * DIRTY_LOW_PERCENT / 100;
+    clean_wanted = false;
+    /* Create thread for write back, cleaning and read ahead. */
     thread_create("cache_write_back", PRI_DEFAULT,
     				cache_write_back_func, NULL);
+    thread_create("cache_clean", PRI_DEFAULT, cache_clean_func, NULL);
     thread_create("cache_read_ahead", PRI_DEFAULT, 
     					cache_read_ahead, NULL);
 }
 
 
+/* Return the bucket of the sector index where SECTOR
+   is chained if it is in the cache. */
+static struct list *
+cache_bucket(block_sector_t sector) {
+    return &cache_index[hash_int((int) sector) & (bucket_cnt - 1)];
+}
+
+
 /* Find the given sector in the cache. Return the pointer
-   to the entry if found. Return a NULL pointer if it does
-   not in the cache yet. */
+   to the entry if found, without locking it. Return a NULL
+   pointer if it does not in the cache yet. Must be called
+   with cache_lock held. */
 struct cache_entry *
 cache_find_sector(block_sector_t sector) {
-    size_t i = 0;
-    while (i < CACHE_ENTRY_NUM) {
-		struct cache_entry* entry = cache +i;
-		lock_acquire(&entry->entry_lock);
-		/* If it is not valid, continue. */
-		if (!entry->valid){
-			lock_release(&entry->entry_lock);
-			i++;
-			continue;
-		}
-		/* If found one.*/
-		if (entry->sector == sector)
-			return entry;
-		lock_release(&entry->entry_lock);
-		i++;
+    struct list *bucket = cache_bucket(sector);
+    struct list_elem *e;
+    lookup_cnt++;
+    for (e = list_begin(bucket); e != list_end(bucket); e = list_next(e)) {
+        struct cache_entry *entry = list_entry(e, struct cache_entry,
+                                               hash_elem);
+        probe_cnt++;
+        /* If found one.*/
+        if (entry->sector == sector)
+            return entry;
     }
     return NULL;
 }
 
 
-/* Write operation for the cache. If cache hit, directly
-   read the data; if miss, first bring in the sector. */
-void
-cache_write(block_sector_t sector, void *buffer,
-							int offset, int size){
-    lock_acquire(&cache_lock);
-    /* Try to find the sector. */
-    struct cache_entry *entry = cache_find_sector(sector);
-    if (entry)
-        lock_release(&cache_lock);
-    else{
+/* Return the entry holding SECTOR, of TYPE, with its
+   lock held, shared or EXCLUSIVE, bringing it in on a miss,
+   reading the disk only if READ. A miss always returns
+   the entry exclusively. Must be called without cache_lock.
+
+   The lock of a busy entry is never waited for with
+   cache_lock held, since its holder may have it pinned
+   and need cache_lock itself. Instead we wait outside and
+   look again if the entry was evicted meanwhile. Disk I/O
+   for a miss is done without cache_lock as well, so that
+   one slow read does not hold up every other lookup. */
+static struct cache_entry *
+cache_acquire(block_sector_t sector, enum cache_type type,
+              bool exclusive, bool read){
+    while (true){
+        lock_acquire(&cache_lock);
+        /* Try to find the sector. */
+        struct cache_entry *entry = cache_find_sector(sector);
         /* If cache miss. */
-        entry = cache_get_sector(sector);
+        if (entry == NULL){
+            /* Its old contents are still on their way to disk. */
+            if (cache_evicting(sector)){
+                cond_wait(&evict_cond, &cache_lock);
+                lock_release(&cache_lock);
+                continue;
+            }
+            entry = cache_install(sector, type);
+            if (entry != NULL)
+                miss_cnt++;
+            lock_release(&cache_lock);
+            /* Every entry is busy, let their holders run. */
+            if (entry == NULL){
+                thread_yield();
+                continue;
+            }
+            cache_fill(entry, read);
+            return entry;
+        }
+        if (exclusive ? rw_lock_try_acquire_write(&entry->entry_lock)
+                      : rw_lock_try_acquire_read(&entry->entry_lock)){
+            cache_note_hit(entry, type);
+            lock_release(&cache_lock);
+            return entry;
+        }
+        /* Busy, wait for it without cache_lock. */
+        lock_release(&cache_lock);
+        if (exclusive)
+            rw_lock_acquire_write(&entry->entry_lock);
+        else
+            rw_lock_acquire_read(&entry->entry_lock);
+        if (entry->valid && entry->sector == sector){
+            lock_acquire(&cache_lock);
+            cache_note_hit(entry, type);
+            lock_release(&cache_lock);
+            return entry;
+        }
+        cache_unlock(entry);
     }
+}
+
+
+/* Release the lock of ENTRY, in whichever mode it
+   is held by the current thread. */
+static void
+cache_unlock(struct cache_entry *entry){
+    if (rw_lock_held_for_write(&entry->entry_lock))
+        rw_lock_release_write(&entry->entry_lock);
+    else
+        rw_lock_release_read(&entry->entry_lock);
+}
+
+
+/* Write operation for the cache. If cache hit, directly
+   write the data; if miss, first bring in the sector,
+   unless the write covers all of it. */
+void
+cache_write(block_sector_t sector, enum cache_type type,
+            const void *buffer, int offset, int size){
+    struct cache_entry *entry = cache_acquire(sector, type, true,
+                                              offset != 0
+                                              || size != BLOCK_SECTOR_SIZE);
     /* Write the data. */
     memcpy(entry->data + offset, buffer, size);
-    entry->dirty = true;
+    cache_mark_dirty(entry);
     entry->accessed = true;
-    lock_release(&entry->entry_lock);
+    rw_lock_release_write(&entry->entry_lock);
 }
 
 
 /* Read operation for the cache. If cache hit, directly
-   read the data; if miss, first bring in the sector. */
+   read the data, sharing the entry with other readers; if
+   miss, first bring in the sector. */
 void
-cache_read_sector(block_sector_t sector, void *buffer,
-									int offset, int size){
-	lock_acquire(&cache_lock);
-	/* Try to find the sector. */
-    struct cache_entry *entry = cache_find_sector(sector);
-    if (entry)
-        lock_release(&cache_lock);
-    else{
-        /* If cache miss. */
-        entry = cache_get_sector(sector);
-    }
+cache_read_sector(block_sector_t sector, enum cache_type type,
+                  void *buffer, int offset, int size){
+    struct cache_entry *entry = cache_acquire(sector, type, false, true);
     /* copy the data out. */
     memcpy(buffer, entry->data + offset, (size_t) size);
     /* Mark as accessed. */
     entry->accessed = true;
-    lock_release(&entry->entry_lock);
+    cache_unlock(entry);
+}
+
+
+/* Pin SECTOR in the cache and return a pointer to its
+   data, which stays valid and unchanged until ENTRY,
+   stored in *ENTRYP, is passed to cache_unpin(). Other
+   readers may pin the sector at the same time. While it
+   is pinned, the caller must not access SECTOR through
+   any other cache function. */
+const void *
+cache_pin_read(block_sector_t sector, enum cache_type type,
+               struct cache_entry **entryp){
+    struct cache_entry *entry = cache_acquire(sector, type, false, true);
+    entry->accessed = true;
+    *entryp = entry;
+    return entry->data;
+}
+
+
+/* Like cache_pin_read(), but the sector is pinned for
+   the caller alone and may be modified through the
+   returned pointer. The sector is marked dirty. */
+void *
+cache_pin_write(block_sector_t sector, enum cache_type type,
+                struct cache_entry **entryp){
+    struct cache_entry *entry = cache_acquire(sector, type, true, true);
+    cache_mark_dirty(entry);
+    entry->accessed = true;
+    *entryp = entry;
+    return entry->data;
 }
 
 
-/* Evict an entry in the cache. Using the clock
-   algorithm. Return the pointer to the entry. */
+/* Unpin ENTRY, pinned by cache_pin_read() or
+   cache_pin_write(). A null ENTRY is ignored. */
+void
+cache_unpin(struct cache_entry *entry){
+    if (entry != NULL)
+        cache_unlock(entry);
+}
+
+
+/* Evict an entry in the cache, using an entry never used
+   yet if there is one or else the replacement policy.
+   Return the pointer to the entry, locked exclusively and
+   out of the index, or NULL if every entry is busy. A
+   dirty victim keeps its data and dirty flag; the caller
+   writes it back. Must be called with cache_lock held. */
 struct cache_entry *
 cache_evict(void){
-    while(1){
-        unsigned idx = 0;
-        for (idx = 0; idx < CACHE_ENTRY_NUM; idx++){
-            struct cache_entry* entry = cache + idx;
-            /* If fail, then skip to next one. */
-            if (!lock_try_acquire(&entry->entry_lock))
-                continue;
-            /* If we find a new entry. */
-            if (!entry->valid){
-                entry->valid = true;
-                return entry;
-            }
-            /* Accessed, give it a second chance */
-            if (entry->accessed){
-                entry->accessed = false;
-                lock_release(&entry->entry_lock);
-                continue;
-            }
-            /* If dirty, write the data back. */
-            if(entry->dirty)
-                block_write(fs_device, entry->sector, entry->data);
-            entry->dirty = false;
+    struct cache_entry *entry;
+    /* If we find a new entry. */
+    if (!list_empty(&free_entries)){
+        entry = list_entry(list_pop_front(&free_entries),
+                           struct cache_entry, queue_elem);
+        if (!rw_lock_try_acquire_write(&entry->entry_lock))
+            NOT_REACHED();
+        entry->valid = true;
+        return entry;
+    }
+    /* Take a clean victim outside the metadata share if
+       there is one, else have the cleaner make more and
+       settle for less. */
+    entry = policy->victim(PASS_CLEAN);
+    if (entry == NULL){
+        lock_acquire(&dirty_lock);
+        clean_wanted = true;
+        cond_signal(&clean_cond, &dirty_lock);
+        lock_release(&dirty_lock);
+        entry = policy->victim(PASS_UNPROTECTED);
+    }
+    if (entry == NULL)
+        entry = policy->victim(PASS_ANY);
+    if (entry == NULL)
+        return NULL;
+    evict_cnt++;
+    /* Brought in by read ahead but never used. */
+    if (entry->read_ahead)
+        ahead_waste_cnt++;
+    if (entry->dirty)
+        dirty_evict_cnt++;
+    /* Drop the old sector from the index. */
+    list_remove(&entry->hash_elem);
+    cache_set_type(entry, CACHE_DATA);
+    return entry;
+}
+
+
+/* Set up the clock policy. */
+static void
+clock_init(void){
+    clock_hand = 0;
+}
+
+
+/* Pick a victim with the clock algorithm, whose hand
+   stays where the last call stopped. Accessed entries
+   get a second chance. */
+static struct cache_entry *
+clock_victim(enum victim_pass pass){
+    size_t i;
+    for (i = 0; i < 2 * cache_cnt; i++){
+        struct cache_entry* entry = cache + clock_hand;
+        clock_hand = (clock_hand + 1) % cache_cnt;
+        /* If fail, then skip to next one. */
+        if (cache_skip(entry, pass)
+            || !rw_lock_try_acquire_write(&entry->entry_lock))
+            continue;
+        /* Accessed, give it a second chance */
+        if (entry->accessed){
+            entry->accessed = false;
+            rw_lock_release_write(&entry->entry_lock);
+            continue;
+        }
+        return entry;
+    }
+    return NULL;
+}
+
+
+/* The clock policy keeps no queue. */
+static void
+clock_insert(struct cache_entry *entry UNUSED){
+}
+
+
+/* The clock policy relies on the accessed bit. */
+static void
+clock_touch(struct cache_entry *entry UNUSED){
+}
+
+
+/* Set up the 2Q policy, with a quarter of the cache for
+   a1in and ghosts for half the cache size. */
+static void
+twoq_init(void){
+    size_t ghost_cnt = cache_cnt / 2;
+    size_t i;
+    list_init(&a1in_queue);
+    list_init(&am_queue);
+    list_init(&a1out_queue);
+    list_init(&free_ghosts);
+    a1in_cnt = 0;
+    a1in_max = cache_cnt / 4;
+    ghosts = malloc(ghost_cnt * sizeof *ghosts);
+    ghost_index = malloc(bucket_cnt * sizeof *ghost_index);
+    if (ghosts == NULL || ghost_index == NULL)
+        PANIC("can't allocate buffer cache");
+    for (i = 0; i < ghost_cnt; i++)
+        list_push_back(&free_ghosts, &ghosts[i].elem);
+    for (i = 0; i < bucket_cnt; i++)
+        list_init(&ghost_index[i]);
+}
+
+
+/* Pick a victim with 2Q: the oldest of a1in if it is over
+   its share, else the least recently used of am. */
+static struct cache_entry *
+twoq_victim(enum victim_pass pass){
+    struct cache_entry *entry = NULL;
+    if (a1in_cnt > a1in_max || list_empty(&am_queue))
+        entry = queue_victim(&a1in_queue, pass);
+    if (entry == NULL)
+        entry = queue_victim(&am_queue, pass);
+    if (entry == NULL)
+        entry = queue_victim(&a1in_queue, pass);
+    if (entry != NULL && entry->queue == CACHE_A1IN){
+        a1in_cnt--;
+        ghost_add(entry->sector);
+    }
+    return entry;
+}
+
+
+/* Put a new entry in am if its sector was evicted from
+   a1in lately, else in a1in. */
+static void
+twoq_insert(struct cache_entry *entry){
+    if (ghost_remove(entry->sector)){
+        entry->queue = CACHE_AM;
+        list_push_front(&am_queue, &entry->queue_elem);
+    }
+    else{
+        entry->queue = CACHE_A1IN;
+        list_push_front(&a1in_queue, &entry->queue_elem);
+        a1in_cnt++;
+    }
+}
+
+
+/* A hit moves an entry to the front of am. A hit in a1in
+   does nothing, as it is likely part of the same burst. */
+static void
+twoq_touch(struct cache_entry *entry){
+    if (entry->queue == CACHE_AM){
+        list_remove(&entry->queue_elem);
+        list_push_front(&am_queue, &entry->queue_elem);
+    }
+}
+
+
+/* Lock and take out the entry nearest the back of QUEUE
+   that is not busy and that PASS allows. Return NULL if
+   there is none. */
+static struct cache_entry *
+queue_victim(struct list *queue, enum victim_pass pass){
+    struct list_elem *e;
+    for (e = list_rbegin(queue); e != list_rend(queue); e = list_prev(e)){
+        struct cache_entry *entry = list_entry(e, struct cache_entry,
+                                               queue_elem);
+        if (!cache_skip(entry, pass)
+            && rw_lock_try_acquire_write(&entry->entry_lock)){
+            list_remove(e);
             return entry;
         }
     }
@@ -151,6 +645,49 @@ cache_evict(void){
 }
 
 
+/* Remember SECTOR in a1out, forgetting the oldest ghost
+   if all are in use. */
+static void
+ghost_add(block_sector_t sector){
+    struct cache_ghost *ghost;
+    if (!list_empty(&free_ghosts))
+        ghost = list_entry(list_pop_front(&free_ghosts),
+                           struct cache_ghost, elem);
+    else if (!list_empty(&a1out_queue)){
+        ghost = list_entry(list_pop_back(&a1out_queue),
+                           struct cache_ghost, elem);
+        list_remove(&ghost->hash_elem);
+    }
+    else
+        return;
+    ghost->sector = sector;
+    list_push_front(&a1out_queue, &ghost->elem);
+    list_push_front(&ghost_index[hash_int((int) sector) & (bucket_cnt - 1)],
+                    &ghost->hash_elem);
+}
+
+
+/* Forget SECTOR if it is in a1out. Return whether it
+   was. */
+static bool
+ghost_remove(block_sector_t sector){
+    struct list *bucket
+      = &ghost_index[hash_int((int) sector) & (bucket_cnt - 1)];
+    struct list_elem *e;
+    for (e = list_begin(bucket); e != list_end(bucket); e = list_next(e)){
+        struct cache_ghost *ghost = list_entry(e, struct cache_ghost,
+                                               hash_elem);
+        if (ghost->sector == sector){
+            list_remove(&ghost->hash_elem);
+            list_remove(&ghost->elem);
+            list_push_front(&free_ghosts, &ghost->elem);
+            return true;
+        }
+    }
+    return false;
+}
+
+
 /* periodically writes all the dirty sectors
    back to disk and then goes to sleep */
 void 
@@ -161,31 +698,197 @@ cache_write_back_func(void *aux UNUSED) {
     }
 }
 
-/* function for writing back dirty sectors to disk. Also
-   first to make sure that it is valid. */
+/* Cleaner thread. Sleeps until too many entries are dirty
+   or eviction found no clean victim, then writes back the
+   oldest dirty entries down to the low-water mark, or half
+   of them if already below. */
+static void
+cache_clean_func(void *aux UNUSED){
+    size_t target;
+    lock_acquire(&dirty_lock);
+    while (true){
+        while (dirty_cnt <= dirty_high && !clean_wanted)
+            cond_wait(&clean_cond, &dirty_lock);
+        clean_wanted = false;
+        clean_cnt++;
+        target = dirty_cnt > dirty_low ? dirty_low : dirty_cnt / 2;
+        lock_release(&dirty_lock);
+        cache_flush(target);
+        lock_acquire(&dirty_lock);
+    }
+}
+
+
+/* function for writing back dirty sectors to disk. */
 void
 cache_write_back(void){
-    size_t i = 0;
-    while (i < CACHE_ENTRY_NUM) {
-        struct cache_entry *entry = cache + i;
-        lock_acquire(&entry->entry_lock);
-		/* Make sure whether valid or not. */
-        /* If not modified, unnecessary to write. */
-		if (!entry->valid || !entry->dirty){
-			lock_release(&entry->entry_lock);
-			i++;
-			continue;
-		}
-        block_write(fs_device, entry->sector, entry->data);
+    cache_flush(0);
+}
+
+
+/* Write back the entries that became dirty first until
+   no more than TARGET are dirty. The picked entries are
+   written in ascending sector order, so the disk head
+   sweeps once. Returns at once if no more than TARGET are
+   dirty. Only reads the data, so readers may share the
+   entries meanwhile. */
+static void
+cache_flush(size_t target){
+    struct dirty_sector local[FLUSH_BATCH_MIN];
+    struct dirty_sector *batch;
+    struct list_elem *e;
+    size_t batch_cnt;
+    size_t written;
+    size_t i;
+
+    lock_acquire(&dirty_lock);
+    if (dirty_cnt > target)
+        flush_cnt++;
+    while (dirty_cnt > target){
+        /* Pick the oldest dirty entries, as many as fit. */
+        batch_cnt = dirty_cnt - target;
+        batch = malloc(batch_cnt * sizeof *batch);
+        if (batch == NULL){
+            batch = local;
+            if (batch_cnt > FLUSH_BATCH_MIN)
+                batch_cnt = FLUSH_BATCH_MIN;
+        }
+        e = list_begin(&dirty_list);
+        for (i = 0; i < batch_cnt; i++, e = list_next(e)){
+            batch[i].entry = list_entry(e, struct cache_entry, dirty_elem);
+            batch[i].sector = batch[i].entry->sector;
+        }
+        lock_release(&dirty_lock);
+
+        /* Write them in sector order. An entry may have been
+           written back or evicted since it was picked. */
+        qsort(batch, batch_cnt, sizeof *batch, dirty_sector_cmp);
+        written = 0;
+        for (i = 0; i < batch_cnt; i++){
+            struct cache_entry *entry = batch[i].entry;
+            rw_lock_acquire_read(&entry->entry_lock);
+            if (entry->dirty && entry->sector == batch[i].sector){
+                block_write(fs_device, entry->sector, entry->data);
+                cache_mark_clean(entry);
+                written++;
+            }
+            rw_lock_release_read(&entry->entry_lock);
+        }
+        lock_acquire(&dirty_lock);
+        flush_sector_cnt += written;
+        if (batch != local){
+            free(batch);
+            break;
+        }
+    }
+    lock_release(&dirty_lock);
+}
+
+
+/* Write back those of the CNT sectors in SECTORS that are
+   cached and dirty, in ascending sector order. SECTORS is
+   sorted in place. Only reads the data, so readers may
+   share the entries meanwhile. */
+void
+cache_flush_sectors(block_sector_t *sectors, size_t cnt){
+    size_t i;
+    qsort(sectors, cnt, sizeof *sectors, sector_cmp);
+    for (i = 0; i < cnt; i++){
+        struct cache_entry *entry;
+        lock_acquire(&cache_lock);
+        entry = cache_find_sector(sectors[i]);
+        /* Evicted, but maybe not on disk yet. */
+        while (entry == NULL && cache_evicting(sectors[i])){
+            cond_wait(&evict_cond, &cache_lock);
+            entry = cache_find_sector(sectors[i]);
+        }
+        lock_release(&cache_lock);
+        if (entry == NULL)
+            continue;
+        /* It may have been evicted before we got the lock. */
+        rw_lock_acquire_read(&entry->entry_lock);
+        if (entry->valid && entry->sector == sectors[i] && entry->dirty){
+            block_write(fs_device, entry->sector, entry->data);
+            cache_mark_clean(entry);
+        }
+        rw_lock_release_read(&entry->entry_lock);
+    }
+}
+
+
+/* Mark ENTRY dirty and put it on dirty_list if it is
+   not there yet. Its lock must be held exclusively. */
+static void
+cache_mark_dirty(struct cache_entry *entry){
+    if (entry->dirty)
+        return;
+    lock_acquire(&dirty_lock);
+    entry->dirty = true;
+    list_push_back(&dirty_list, &entry->dirty_elem);
+    dirty_cnt++;
+    if (dirty_cnt > dirty_high)
+        cond_signal(&clean_cond, &dirty_lock);
+    lock_release(&dirty_lock);
+}
+
+
+/* Mark ENTRY clean and take it off dirty_list. Its lock
+   must be held, though shared is enough. */
+static void
+cache_mark_clean(struct cache_entry *entry){
+    lock_acquire(&dirty_lock);
+    if (entry->dirty){
         entry->dirty = false;
-        lock_release(&entry->entry_lock);
-		i++;
+        list_remove(&entry->dirty_elem);
+        dirty_cnt--;
+    }
+    lock_release(&dirty_lock);
+}
+
+
+/* Order dirty_sector A_ and B_ by sector number. */
+static int
+dirty_sector_cmp(const void *a_, const void *b_){
+    const struct dirty_sector *a = a_;
+    const struct dirty_sector *b = b_;
+    return a->sector < b->sector ? -1 : a->sector > b->sector;
+}
+
+
+/* Order block_sector_t A_ and B_. */
+static int
+sector_cmp(const void *a_, const void *b_){
+    const block_sector_t *a = a_;
+    const block_sector_t *b = b_;
+    return *a < *b ? -1 : *a > *b;
+}
+
+
+/* Ask the read ahead thread to bring SECTOR, of TYPE,
+   into the cache. The request is dropped if the queue is
+   full. */
+void
+cache_read_ahead_request(block_sector_t sector, enum cache_type type){
+    struct entry_read *ahead_entry;
+    lock_acquire(&ahead_lock);
+    if (ahead_cnt >= READ_AHEAD_MAX){
+        lock_release(&ahead_lock);
+        return;
     }
+    ahead_entry = malloc(sizeof *ahead_entry);
+    if (ahead_entry != NULL){
+        ahead_entry->sector = sector;
+        ahead_entry->type = type;
+        list_push_back(&read_ahead_queue, &ahead_entry->elem);
+        ahead_cnt++;
+        cond_signal(&ahead_cond, &ahead_lock);
+    }
+    lock_release(&ahead_lock);
 }
 
 
-/* Function for read ahead. Do some operation
-   in the waiting list. */
+/* Function for read ahead. Take the requests in the
+   waiting list one by one and bring them in. */
 void 
 cache_read_ahead(void *aux UNUSED){
     while (true) {
@@ -194,22 +897,181 @@ cache_read_ahead(void *aux UNUSED){
             cond_wait(&ahead_cond, &ahead_lock);
         struct entry_read *ahead_entry = list_entry(
 			list_pop_front(&read_ahead_queue), struct entry_read, elem);
-        // free(ahead_entry);
-		cache_read_sector(ahead_entry->sector, NULL, BLOCK_SECTOR_SIZE, 0);
+        ahead_cnt--;
         lock_release(&ahead_lock);
+        cache_prefetch(ahead_entry->sector, ahead_entry->type);
+        free(ahead_entry);
+    }
+}
+
+
+/* Bring SECTOR, of TYPE, into the cache unless it is
+   already there, marking it as brought in by read ahead.
+   The request is dropped if no entry is free to take it. */
+static void
+cache_prefetch(block_sector_t sector, enum cache_type type){
+    struct cache_entry *entry = NULL;
+    lock_acquire(&cache_lock);
+    if (cache_find_sector(sector) == NULL && !cache_evicting(sector))
+        entry = cache_install(sector, type);
+    if (entry == NULL){
+        lock_release(&cache_lock);
+        return;
+    }
+    ahead_read_cnt++;
+    entry->read_ahead = true;
+    lock_release(&cache_lock);
+    cache_fill(entry, true);
+    entry->accessed = true;
+    rw_lock_release_write(&entry->entry_lock);
+}
+
+
+/* Count a hit on ENTRY, which is a read ahead hit the
+   first time a sector brought in early is used, and tell
+   the policy. A data entry used as TYPE metadata becomes
+   metadata. Must be called with cache_lock held. */
+static void
+cache_note_hit(struct cache_entry *entry, enum cache_type type){
+    hit_cnt++;
+    policy->touch(entry);
+    if (type == CACHE_META)
+        cache_set_type(entry, CACHE_META);
+    if (entry->read_ahead){
+        entry->read_ahead = false;
+        ahead_hit_cnt++;
     }
 }
 
 
-/* In terms of cache miss, bring the sector in
-   and set the parameters. May need to do eviction. */
-struct cache_entry * 
-cache_get_sector(block_sector_t sector){
+/* Set the TYPE of ENTRY, keeping meta_cnt right. Must be
+   called with cache_lock held. */
+static void
+cache_set_type(struct cache_entry *entry, enum cache_type type){
+    if (entry->type == type)
+        return;
+    if (type == CACHE_META)
+        meta_cnt++;
+    else
+        meta_cnt--;
+    entry->type = type;
+}
+
+
+/* Whether a search for a victim on PASS must pass over
+   ENTRY: dirty entries only on the first pass, metadata
+   within the protected share on all but the last. Must
+   be called with cache_lock held. */
+static bool
+cache_skip(struct cache_entry *entry, enum victim_pass pass){
+    if (pass == PASS_CLEAN && entry->dirty)
+        return true;
+    return (pass != PASS_ANY && entry->type == CACHE_META
+            && meta_cnt <= meta_max);
+}
+
+
+/* In terms of cache miss, take a victim entry for SECTOR,
+   of TYPE, and put it in the index, locked exclusively,
+   so that others who want SECTOR wait on the entry lock
+   rather than bring it in twice. Return NULL if every
+   entry is busy. Must be called with cache_lock held, and
+   keeps it; the caller must release it and then call
+   cache_fill() to do the disk I/O. */
+static struct cache_entry *
+cache_install(block_sector_t sector, enum cache_type type){
     struct cache_entry * entry = cache_evict();
-    ASSERT(entry);
-    entry->dirty = false;
+    if (entry == NULL)
+        return NULL;
+    /* A dirty old sector is written back by cache_fill(). */
+    if (entry->dirty){
+        cache_mark_clean(entry);
+        entry->old_sector = entry->sector;
+        entry->write_back = true;
+        list_push_back(&evicting_list, &entry->evict_elem);
+    }
+    entry->read_ahead = false;
+    cache_set_type(entry, type);
     entry->sector = sector;
-    block_read(fs_device, sector, entry->data);
-    lock_release(&cache_lock);
+    list_push_front(cache_bucket(sector), &entry->hash_elem);
+    policy->insert(entry);
     return entry;
+}
+
+
+/* Finish bringing in ENTRY, returned by cache_install(),
+   without cache_lock held: write back the dirty sector it
+   held before, if any, then read its new sector if READ.
+   If READ is false the caller is about to overwrite the
+   whole sector, so the disk is not read. */
+static void
+cache_fill(struct cache_entry *entry, bool read){
+    if (entry->write_back){
+        block_write(fs_device, entry->old_sector, entry->data);
+        lock_acquire(&cache_lock);
+        entry->write_back = false;
+        list_remove(&entry->evict_elem);
+        cond_broadcast(&evict_cond, &cache_lock);
+        lock_release(&cache_lock);
+    }
+    if (read)
+        block_read(fs_device, entry->sector, entry->data);
+}
+
+
+/* Whether the old contents of SECTOR are being written
+   back after eviction. Must be called with cache_lock
+   held. */
+static bool
+cache_evicting(block_sector_t sector){
+    struct list_elem *e;
+    for (e = list_begin(&evicting_list); e != list_end(&evicting_list);
+         e = list_next(e))
+        if (list_entry(e, struct cache_entry, evict_elem)->old_sector
+            == sector)
+            return true;
+    return false;
+}
+
+
+/* Fill STATS with the counters of the cache and of the
+   file system device. */
+void
+cache_get_stats(struct cache_stats *stats){
+    lock_acquire(&cache_lock);
+    stats->hit_cnt = hit_cnt;
+    stats->miss_cnt = miss_cnt;
+    stats->evict_cnt = evict_cnt;
+    stats->dirty_evict_cnt = dirty_evict_cnt;
+    stats->ahead_read_cnt = ahead_read_cnt;
+    stats->ahead_hit_cnt = ahead_hit_cnt;
+    stats->ahead_waste_cnt = ahead_waste_cnt;
+    lock_acquire(&dirty_lock);
+    stats->flush_cnt = flush_cnt;
+    stats->flush_sector_cnt = flush_sector_cnt;
+    stats->clean_cnt = clean_cnt;
+    lock_release(&dirty_lock);
+    lock_release(&cache_lock);
+    stats->device_read_cnt = block_read_cnt(fs_device);
+    stats->device_write_cnt = block_write_cnt(fs_device);
+    stats->device_read_seek = block_read_seek(fs_device);
+}
+
+
+/* Print the statistics of the cache. */
+void
+cache_print_stats(void){
+    printf("Cache: %zu sectors, %lld lookups, %lld probes\n",
+           cache_cnt, lookup_cnt, probe_cnt);
+    printf("Cache: %s policy, %lld hits, %lld misses\n",
+           policy != NULL ? policy->name : cache_policy_name,
+           hit_cnt, miss_cnt);
+    printf("Cache: %zu metadata sectors, %zu protected\n",
+           meta_cnt, meta_max);
+    printf("Cache: %lld evictions (%lld dirty), "
+           "%lld write backs (%lld sectors), %lld cleaner runs\n",
+           evict_cnt, dirty_evict_cnt, flush_cnt, flush_sector_cnt,
+           clean_cnt);
+    printf("Cache: %lld read ahead, %lld hits, %lld wasted\n",
+           ahead_read_cnt, ahead_hit_cnt, ahead_waste_cnt);
 }
\ No newline at end of file
@@ -2,18 +2,45 @@
 #define FILESYS_CACHE_H
 
 /* Include the header file we need. */
+#include <cache-stats.h>
 #include "devices/block.h"
 #include "threads/synch.h"
 
+/* Default number of entries in the cache. */
+#define CACHE_ENTRY_NUM 64
+
+/* Kind of sector, as told by the caller. Metadata keeps
+   a protected share of the cache. */
+enum cache_type {
+    CACHE_DATA,                     /* File data. */
+    CACHE_META                      /* Inodes, index blocks,
+                                       directories, free map. */
+};
+
+/* Queue of the replacement policy an entry is in. */
+enum cache_queue {
+    CACHE_FREE,                     /* Not used yet. */
+    CACHE_A1IN,                     /* 2Q queue of first touched. */
+    CACHE_AM                        /* 2Q queue of reused. */
+};
 
 /* Entry in the cache array. */
 struct cache_entry {
-    char data[BLOCK_SECTOR_SIZE];   /* Data buffer. */
-    struct lock entry_lock;         /* Lock for this entry. */
+    char *data;                     /* Data buffer, one sector. */
+    struct rw_lock entry_lock;      /* Lock for this entry. */
+    struct list_elem hash_elem;     /* Elem in the sector index. */
+    struct list_elem dirty_elem;    /* Elem in the dirty list. */
+    struct list_elem queue_elem;    /* Elem in a policy queue. */
+    struct list_elem evict_elem;    /* Elem in the evicting list. */
+    block_sector_t old_sector;      /* Sector being written back. */
+    bool write_back;                /* In the evicting list? */
+    enum cache_queue queue;         /* Queue it is in. */
+    enum cache_type type;           /* Metadata or data. */
     block_sector_t sector;          /* Sector number of the data. */
     bool valid;                     /* Whether initialized. */
     bool dirty;                     /* Modified or not. */
     bool accessed;                  /* Been read or not. */
+    bool read_ahead;                /* Read ahead and not used yet. */
 };
 
 
@@ -21,15 +48,36 @@ struct cache_entry {
 struct entry_read {
     struct list_elem elem;          /* Elem for put in list. */
     block_sector_t sector;          /* Sector number. */
+    enum cache_type type;           /* Metadata or data. */
 };
 
 
+/* Number of entries requested by "-cache=N". */
+extern size_t cache_capacity;
+
+/* Replacement policy chosen by "-cache-policy=NAME". */
+extern const char *cache_policy_name;
+
+/* Percentage of the cache kept for metadata, set by
+   "-cache-meta=PERCENT". */
+extern int cache_meta_percent;
+
 /* Function for cache operation. */
 void cache_init(void);
-void cache_write(block_sector_t sector, void *buffer,
-				int offset, int size);
-void cache_read_sector(block_sector_t sector, void *buffer,
-						int offset, int size);
+void cache_write(block_sector_t sector, enum cache_type type,
+                 const void *buffer, int offset, int size);
+void cache_read_sector(block_sector_t sector, enum cache_type type,
+                       void *buffer, int offset, int size);
+const void *cache_pin_read(block_sector_t sector, enum cache_type type,
+                           struct cache_entry **entryp);
+void *cache_pin_write(block_sector_t sector, enum cache_type type,
+                      struct cache_entry **entryp);
+void cache_unpin(struct cache_entry *entry);
 void cache_write_back(void);
+void cache_flush_sectors(block_sector_t *sectors, size_t cnt);
+void cache_read_ahead_request(block_sector_t sector,
+                              enum cache_type type);
+void cache_get_stats(struct cache_stats *stats);
+void cache_print_stats(void);
 
 #endif /* filesys/cache.h */
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -27,7 +28,7 @@ struct dir_entry
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
-dir_create(block_sector_t sector, size_t entry_cnt, char *dir)
+dir_create(block_sector_t sector, size_t entry_cnt, struct dir *dir)
 {
   /* Get the inode of the directory. */
   struct inode *inode = dir_get_inode(dir);
@@ -107,29 +108,59 @@ dir_get_inode (struct dir *dir)
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   Entries are compared in place in the pinned cache sector;
+   only one that straddles two sectors is copied out. */
 static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
   struct dir_entry e;
+  struct cache_entry *entry;
+  const uint8_t *data;
+  off_t avail;
   size_t ofs;
   /* Check the validity of the given arguments. */
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
-  /* For each inode. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    /* If find the name and in use. */
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        /* Success. */
-        return true;
-      }
+  /* For each sector. */
+  for (ofs = 0;
+       (data = inode_pin_read (dir->inode, ofs, &avail, &entry)) != NULL; )
+    {
+      /* For each entry wholly inside it. */
+      for (; avail >= (off_t) sizeof e;
+           avail -= sizeof e, data += sizeof e, ofs += sizeof e)
+        {
+          const struct dir_entry *p = (const struct dir_entry *) data;
+          /* If find the name and in use. */
+          if (p->in_use && !strcmp (name, p->name))
+            {
+              if (ep != NULL)
+                *ep = *p;
+              if (ofsp != NULL)
+                *ofsp = ofs;
+              cache_unpin (entry);
+              /* Success. */
+              return true;
+            }
+        }
+      cache_unpin (entry);
+      /* An entry running into the next sector. */
+      if (avail > 0)
+        {
+          if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+            break;
+          if (e.in_use && !strcmp (name, e.name))
+            {
+              if (ep != NULL)
+                *ep = e;
+              if (ofsp != NULL)
+                *ofsp = ofs;
+              return true;
+            }
+          ofs += sizeof e;
+        }
+    }
   /* Fail. */
   return false;
 }
@@ -156,11 +187,13 @@ dir_lookup (const struct dir *dir, const char *name,
   else if (strcmp(name, ".") == 0)
     *inode = inode_reopen(dir->inode);
   /* If successfully look up. */
-  else if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  /* If failed to look up. */
   else
-    *inode = NULL;
+    {
+      lock_acquire (&dir->inode->dir_lock);
+      *inode = (lookup (dir, name, &e, NULL)
+                ? inode_open (e.inode_sector) : NULL);
+      lock_release (&dir->inode->dir_lock);
+    }
   /* Return the result. */
   return *inode != NULL;
 }
@@ -187,6 +220,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
     return false;
 
   /* Check that NAME is not in use. */
+  lock_acquire (&dir->inode->dir_lock);
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
@@ -209,6 +243,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 
  done:
   /* Finished the process. */
+  lock_release (&dir->inode->dir_lock);
   return success;
 }
 
@@ -239,6 +274,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (curr_val != NULL);
 
   /* Find directory entry. */
+  lock_acquire (&dir->inode->dir_lock);
   if (!lookup (dir, curr_val, &e, &ofs))
     goto done;
   /* If it has done. */
@@ -246,7 +282,7 @@ dir_remove (struct dir *dir, const char *name)
     goto done;
 
   if (thread_current()->cwd)
-    return false;
+    goto done;
 
   /* Open inode. */
   inode = inode_open (e.inode_sector);
@@ -264,6 +300,7 @@ dir_remove (struct dir *dir, const char *name)
 
  done:
   /* Finished, close the inode. */
+  lock_release (&dir->inode->dir_lock);
   inode_close (inode);
   return success;
 }
@@ -276,7 +313,9 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
   /* Iterate through the directory. */
+  lock_acquire (&dir->inode->dir_lock);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       /* Move the pointer. */
@@ -285,11 +324,13 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
         {
           /* Copy the name. */
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
+          break;
         } 
     }
-    /* No more entry. */
-  return false;
+  lock_release (&dir->inode->dir_lock);
+  /* False if no more entry. */
+  return found;
 }
 
 
@@ -1,5 +1,6 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include <round.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
@@ -9,8 +10,17 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    off_t ahead_pos;            /* Where a sequential read would start. */
+    off_t ahead_end;            /* End of sectors already read ahead. */
+    int ahead_window;           /* Sectors to read ahead, 0 if random. */
   };
 
+/* Bounds on the read ahead window, in sectors. */
+#define READ_AHEAD_MIN 2
+#define READ_AHEAD_MAX 32
+
+static void file_read_ahead (struct file *, off_t start, off_t end);
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
@@ -69,10 +79,47 @@ off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  file_read_ahead (file, file->pos, file->pos + bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
 
+/* Called after FILE has read bytes START through END.  If the
+   read continued the previous one, grows the read ahead window
+   and asks for the sectors past END that it covers; otherwise
+   shrinks the window back to nothing. */
+static void
+file_read_ahead (struct file *file, off_t start, off_t end) 
+{
+  off_t first, last;
+
+  if (start != file->ahead_pos || end == start)
+    {
+      file->ahead_pos = end;
+      file->ahead_end = 0;
+      file->ahead_window = 0;
+      return;
+    }
+  file->ahead_pos = end;
+  if (file->ahead_window == 0)
+    file->ahead_window = READ_AHEAD_MIN;
+  else if (file->ahead_window < READ_AHEAD_MAX)
+    file->ahead_window *= 2;
+
+  /* Sectors after the one holding END, less those already
+     asked for. */
+  first = ROUND_UP (end, BLOCK_SECTOR_SIZE);
+  last = first + file->ahead_window * BLOCK_SECTOR_SIZE;
+  if (first < file->ahead_end)
+    first = file->ahead_end;
+  if (first < last)
+    {
+      inode_read_ahead (file->inode, first,
+                        (last - first) / BLOCK_SECTOR_SIZE);
+      file->ahead_end = last;
+    }
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually read,
@@ -143,6 +190,26 @@ file_allow_write (struct file *file)
     }
 }
 
+/* Writes FILE's dirty data back to disk, along with its inode
+   unless DATA_ONLY.  See inode_sync(). */
+void
+file_sync (struct file *file, bool data_only)
+{
+  ASSERT (file != NULL);
+  inode_sync (file->inode, data_only);
+}
+
+/* Reserves space for bytes OFFSET through OFFSET + LEN - 1 of
+   FILE without writing it, growing FILE to OFFSET + LEN bytes if
+   it is shorter.  Returns false on failure.  See
+   inode_allocate(). */
+bool
+file_allocate (struct file *file, off_t offset, off_t len)
+{
+  ASSERT (file != NULL);
+  return inode_allocate (file->inode, offset, len);
+}
+
 /* Returns the size of FILE in bytes. */
 off_t
 file_length (struct file *file) 
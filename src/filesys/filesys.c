@@ -11,6 +11,10 @@
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* Inode layout for a newly formatted file system, set by the
+   "-layout=NAME" kernel command-line option. */
+const char *filesys_layout_name = "blocks";
+
 /* Static function for operation. */
 static void do_format (void);
 
@@ -25,9 +29,25 @@ filesys_init (bool format){
   cache_init();
   inode_init ();
   free_map_init ();
-  /* Check whether necessary to reformat. */
-  if (format) 
+  /* Check whether necessary to reformat. New inodes take
+     the layout chosen at format time, which the root
+     directory records. */
+  if (format){
+    if (!strcmp (filesys_layout_name, "blocks"))
+      inode_set_layout (INODE_BLOCKS);
+    else if (!strcmp (filesys_layout_name, "extents"))
+      inode_set_layout (INODE_EXTENTS);
+    else
+      PANIC ("unknown inode layout `%s'", filesys_layout_name);
     do_format ();
+  }
+  else{
+    struct inode *root = inode_open (ROOT_DIR_SECTOR);
+    if (root == NULL)
+      PANIC ("can't open root directory");
+    inode_set_layout (inode_get_layout (root));
+    inode_close (root);
+  }
   /* Reopen the free map. */
   free_map_open ();
 }
@@ -68,7 +88,7 @@ filesys_create (const char *name, off_t initial_size)
   block_sector_t parent = inode_get_inumber(dir_get_inode(dir));
   /* Check whether everything success. */
   bool success = (dir != NULL
-               && free_map_allocate (1, &inode_sector)
+               && free_map_allocate_inode (parent, false, &inode_sector)
                && inode_create (inode_sector, initial_size, parent, false)
                && dir_add (dir, curr_val, inode_sector));
   /* If failed to do so. */
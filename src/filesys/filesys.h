@@ -12,6 +12,9 @@
 /* Block device that contains the file system. */
 struct block *fs_device;
 
+/* Inode layout chosen by "-layout=NAME" when formatting. */
+extern const char *filesys_layout_name;
+
 /* Functions for file system operation. */
 void filesys_init (bool format);
 void filesys_done (void);
@@ -1,12 +1,54 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <limits.h>
+#include <round.h>
+#include <string.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Number of bits of the free map in one sector of its file. */
+#define SECTOR_BITS (BLOCK_SECTOR_SIZE * CHAR_BIT)
+
+/* Number of sectors in a region.  A count of free sectors is
+   kept for each region, so that searches skip full regions
+   without looking at their bits. */
+#define REGION_SECTORS 512
+
+/* Number of sectors in a block group.  Inodes are placed by
+   group, so that a directory's files and their data end up
+   close to each other on disk. */
+#define GROUP_SECTORS (2 * REGION_SECTORS)
+
+/* Free sectors a group keeps for the data of the files already
+   in it.  New inodes go to another group once it has fewer. */
+#define GROUP_RESERVE (GROUP_SECTORS / 8)
+
+/* Inode placement policy, set by the "-alloc=NAME" kernel
+   command-line option: "groups" to place inodes by block group,
+   "next-fit" to place them wherever free_map_allocate() would. */
+const char *free_map_alloc_name = "groups";
+static bool use_groups;
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct bitmap *dirty_map;     /* Free map file sectors to write. */
+static size_t *region_free;          /* Free sectors in each region. */
+static size_t region_cnt;            /* Number of regions. */
+static size_t next_fit;              /* Where free_map_allocate() looks. */
+static struct lock free_map_lock;    /* Protects all of the above. */
+
+static bool allocate (size_t start, size_t cnt, block_sector_t *);
+static size_t find_run (size_t start, size_t end, size_t cnt);
+static void set_sectors (block_sector_t, size_t, bool used);
+static void count_regions (void);
+static size_t group_free (size_t group);
+static size_t emptiest_group (size_t group);
+static void mark_dirty (block_sector_t, size_t);
+static bool flush_dirty (void);
 
 /* Initializes the free map. */
 void
@@ -17,36 +59,369 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  dirty_map = bitmap_create (DIV_ROUND_UP (bitmap_size (free_map),
+                                           SECTOR_BITS));
+  if (dirty_map == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
+  region_cnt = DIV_ROUND_UP (bitmap_size (free_map), REGION_SECTORS);
+  region_free = malloc (region_cnt * sizeof *region_free);
+  if (region_free == NULL)
+    PANIC ("region creation failed--file system device is too large");
+  count_regions ();
+  lock_init (&free_map_lock);
+
+  if (!strcmp (free_map_alloc_name, "groups"))
+    use_groups = true;
+  else if (!strcmp (free_map_alloc_name, "next-fit"))
+    use_groups = false;
+  else
+    PANIC ("unknown allocation policy `%s'", free_map_alloc_name);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  The search starts where the last one
+   left off, so that it does not cross the allocated sectors at
+   the start of the disk every time.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  success = allocate (next_fit, cnt, sectorp);
+  if (success)
+    next_fit = *sectorp + cnt;
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Like free_map_allocate(), but takes the first CNT free
+   consecutive sectors at or after GOAL if there are any, so
+   that a file growing from GOAL stays contiguous. */
+bool
+free_map_allocate_near (block_sector_t goal, size_t cnt,
+                        block_sector_t *sectorp)
+{
+  bool success;
+
+  lock_acquire (&free_map_lock);
+  success = allocate (goal, cnt, sectorp);
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Allocates a sector for the inode of a new file, or of a new
+   directory if IS_DIR, whose parent directory's inode is in
+   sector PARENT, and stores it into *SECTORP.
+
+   With block groups, a file's inode goes into the first free
+   sector of its parent's group, so that the data that follows
+   it stays near the directory.  A directory's inode goes into
+   the group with the most free sectors, so that directories
+   spread over the disk and leave room for their files.  A file
+   whose parent's group is nearly full is placed the same way.
+   Returns false if the disk is full or the free map could not
+   be written. */
+bool
+free_map_allocate_inode (block_sector_t parent, bool is_dir,
+                         block_sector_t *sectorp)
+{
+  size_t group;
+  bool success;
+
+  if (!use_groups)
+    return free_map_allocate (1, sectorp);
+
+  lock_acquire (&free_map_lock);
+  group = parent / GROUP_SECTORS;
+  if (group * GROUP_SECTORS >= bitmap_size (free_map))
+    group = 0;
+  if (is_dir || group_free (group) < GROUP_RESERVE)
+    group = emptiest_group (group);
+  success = allocate (group * GROUP_SECTORS, 1, sectorp);
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Allocates the first CNT free consecutive sectors at or after
+   START, or failing that the first ones on the disk, and stores
+   the first into *SECTORP.  Returns false if there are none or
+   the free map could not be written.  The caller must hold
+   free_map_lock. */
+static bool
+allocate (size_t start, size_t cnt, block_sector_t *sectorp)
+{
+  size_t size = bitmap_size (free_map);
+  size_t sector = BITMAP_ERROR;
+  size_t wrap_end = start + cnt;
+
+  if (start < size)
+    sector = find_run (start, size, cnt);
+  if (start >= size || wrap_end > size)
+    wrap_end = size;
+  if (sector == BITMAP_ERROR)
+    sector = find_run (0, wrap_end, cnt);
+  if (sector == BITMAP_ERROR)
+    return false;
+
+  set_sectors (sector, cnt, true);
+  if (!flush_dirty ())
+    {
+      set_sectors (sector, cnt, false);
+      return false;
+    }
+  *sectorp = sector;
+  return true;
+}
+
+/* Returns the first of CNT free consecutive sectors that lie
+   between START and END, or BITMAP_ERROR if there are none.
+   Regions with no free sectors are skipped whole.  A run cannot
+   cross one, so each stretch of regions between full ones is
+   searched on its own with bitmap_scan_range(), which looks at a
+   whole element of the free map at a time, and a stretch with
+   fewer than CNT free sectors in all is not searched at all.
+   The caller must hold free_map_lock. */
+static size_t
+find_run (size_t start, size_t end, size_t cnt)
+{
+  size_t i = start;
+
+  if (cnt == 0)
+    return start;
+  while (i < end)
+    {
+      size_t region = i / REGION_SECTORS;
+      size_t stretch_end = region;
+      size_t stretch_free = 0;
+      size_t sector;
+
+      while (stretch_end < region_cnt && region_free[stretch_end] > 0)
+        stretch_free += region_free[stretch_end++];
+      if (stretch_end == region)
+        {
+          i = (region + 1) * REGION_SECTORS;
+          continue;
+        }
+      stretch_end *= REGION_SECTORS;
+      if (stretch_end > end)
+        stretch_end = end;
+      if (stretch_free >= cnt)
+        {
+          sector = bitmap_scan_range (free_map, i, stretch_end, cnt, false);
+          if (sector != BITMAP_ERROR)
+            return sector;
+        }
+      i = stretch_end;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Marks the CNT sectors starting at SECTOR as USED or free,
+   keeping the region counts up to date and noting the free map
+   sectors to write.  The caller must hold free_map_lock. */
+static void
+set_sectors (block_sector_t sector, size_t cnt, bool used)
+{
+  size_t end = sector + cnt;
+  size_t i = sector;
+
+  bitmap_set_multiple (free_map, sector, cnt, used);
+  while (i < end)
+    {
+      size_t region = i / REGION_SECTORS;
+      size_t region_end = (region + 1) * REGION_SECTORS;
+      size_t n = (end < region_end ? end : region_end) - i;
+      if (used)
+        region_free[region] -= n;
+      else
+        region_free[region] += n;
+      i += n;
+    }
+  mark_dirty (sector, cnt);
+}
+
+/* Recomputes the count of free sectors in each region from the
+   free map. */
+static void
+count_regions (void)
+{
+  size_t size = bitmap_size (free_map);
+  size_t region;
+
+  for (region = 0; region < region_cnt; region++)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      size_t start = region * REGION_SECTORS;
+      size_t cnt = size - start;
+      if (cnt > REGION_SECTORS)
+        cnt = REGION_SECTORS;
+      region_free[region] = bitmap_count (free_map, start, cnt, false);
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  set_sectors (sector, cnt, false);
+  flush_dirty ();
+  lock_release (&free_map_lock);
+}
+
+/* Initializes BATCH as empty. */
+void
+free_map_batch_init (struct free_map_batch *batch)
+{
+  batch->run_cnt = 0;
+}
+
+/* Adds the CNT sectors starting at SECTOR to BATCH, extending
+   its last run if they follow it.  Flushes BATCH first if it is
+   full. */
+void
+free_map_batch_add (struct free_map_batch *batch, block_sector_t sector,
+                    size_t cnt)
+{
+  if (batch->run_cnt > 0)
+    {
+      size_t last = batch->run_cnt - 1;
+      if (batch->runs[last].start + batch->runs[last].cnt == sector)
+        {
+          batch->runs[last].cnt += cnt;
+          return;
+        }
+    }
+  if (batch->run_cnt == FREE_MAP_BATCH_RUNS)
+    free_map_batch_flush (batch);
+  batch->runs[batch->run_cnt].start = sector;
+  batch->runs[batch->run_cnt].cnt = cnt;
+  batch->run_cnt++;
+}
+
+/* Makes all the sectors in BATCH available for use, writing
+   each changed sector of the free map once, and empties
+   BATCH. */
+void
+free_map_batch_flush (struct free_map_batch *batch)
+{
+  size_t i;
+
+  if (batch->run_cnt == 0)
+    return;
+  lock_acquire (&free_map_lock);
+  for (i = 0; i < batch->run_cnt; i++)
+    {
+      ASSERT (bitmap_all (free_map, batch->runs[i].start,
+                          batch->runs[i].cnt));
+      set_sectors (batch->runs[i].start, batch->runs[i].cnt, false);
+    }
+  flush_dirty ();
+  lock_release (&free_map_lock);
+  batch->run_cnt = 0;
+}
+
+/* Returns the number of free sectors in block GROUP.  The
+   caller must hold free_map_lock. */
+static size_t
+group_free (size_t group)
+{
+  size_t region = group * (GROUP_SECTORS / REGION_SECTORS);
+  size_t end = region + GROUP_SECTORS / REGION_SECTORS;
+  size_t cnt = 0;
+
+  for (; region < end && region < region_cnt; region++)
+    cnt += region_free[region];
+  return cnt;
+}
+
+/* Returns the block group with the most free sectors, looking
+   first at the ones after GROUP, so that ties go to the next
+   group over.  The caller must hold free_map_lock. */
+static size_t
+emptiest_group (size_t group)
+{
+  size_t group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  size_t best = group;
+  size_t best_free = 0;
+  size_t i;
+
+  for (i = 1; i <= group_cnt; i++)
+    {
+      size_t g = (group + i) % group_cnt;
+      size_t cnt = group_free (g);
+      if (cnt > best_free)
+        {
+          best = g;
+          best_free = cnt;
+        }
+    }
+  return best;
+}
+
+/* Notes that the sectors of the free map file holding the bits
+   for the CNT sectors starting at SECTOR need to be written. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t first = sector / SECTOR_BITS;
+  size_t last = (sector + cnt - 1) / SECTOR_BITS;
+
+  if (cnt > 0)
+    bitmap_set_multiple (dirty_map, first, last - first + 1, true);
+}
+
+/* Writes the sectors of the free map file that changed since
+   they were last written, rather than the whole free map.
+   Before the free map file exists, does nothing, since
+   free_map_create() writes all of it.  Returns false if a
+   sector could not be written; it stays marked to be written
+   next time. */
+static bool
+flush_dirty (void)
+{
+  size_t i;
+  bool success = true;
+
+  if (free_map_file == NULL)
+    return true;
+  for (i = 0; i < bitmap_size (dirty_map); i++)
+    if (bitmap_test (dirty_map, i))
+      {
+        size_t start = i * SECTOR_BITS;
+        size_t cnt = bitmap_size (free_map) - start;
+        if (cnt > SECTOR_BITS)
+          cnt = SECTOR_BITS;
+        if (bitmap_write_range (free_map, free_map_file, start, cnt))
+          bitmap_reset (dirty_map, i);
+        else
+          success = false;
+      }
+  return success;
+}
+
+/* Stores in *FREE_CNT the number of free sectors and in
+   *RUN_CNT the number of runs of consecutive free sectors they
+   form. */
+void
+free_map_count (size_t *free_cnt, size_t *run_cnt)
+{
+  size_t i;
+
+  *free_cnt = *run_cnt = 0;
+  lock_acquire (&free_map_lock);
+  for (i = 0; i < bitmap_size (free_map); i++)
+    if (!bitmap_test (free_map, i))
+      {
+        if (i == 0 || bitmap_test (free_map, i - 1))
+          ++*run_cnt;
+        ++*free_cnt;
+      }
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,6 +433,7 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  count_regions ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
@@ -82,4 +458,5 @@ free_map_create (void)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty_map, false);
 }
@@ -5,6 +5,26 @@
 #include <stddef.h>
 #include "devices/block.h"
 
+/* Number of runs a free_map_batch holds before it is flushed. */
+#define FREE_MAP_BATCH_RUNS 32
+
+/* Sectors to be released together, as runs of consecutive
+   sectors, so that the free map is rewritten once for all of
+   them rather than once per sector. */
+struct free_map_batch
+  {
+    size_t run_cnt;                     /* Number of runs in use. */
+    struct
+      {
+        block_sector_t start;           /* First sector. */
+        size_t cnt;                     /* Number of sectors. */
+      }
+    runs[FREE_MAP_BATCH_RUNS];
+  };
+
+/* Inode placement policy chosen by "-alloc=NAME". */
+extern const char *free_map_alloc_name;
+
 void free_map_init (void);
 void free_map_read (void);
 void free_map_create (void);
@@ -12,6 +32,13 @@ void free_map_open (void);
 void free_map_close (void);
 
 bool free_map_allocate (size_t, block_sector_t *);
+bool free_map_allocate_near (block_sector_t, size_t, block_sector_t *);
+bool free_map_allocate_inode (block_sector_t parent, bool is_dir,
+                              block_sector_t *);
 void free_map_release (block_sector_t, size_t);
+void free_map_batch_init (struct free_map_batch *);
+void free_map_batch_add (struct free_map_batch *, block_sector_t, size_t);
+void free_map_batch_flush (struct free_map_batch *);
+void free_map_count (size_t *free_cnt, size_t *run_cnt);
 
 #endif /* filesys/free-map.h */
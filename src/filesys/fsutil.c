@@ -7,6 +7,8 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -56,6 +58,29 @@ fsutil_cat (char **argv)
   file_close (file);
 }
 
+/* Reports how file ARGV[1] is laid out on disk: how many runs
+   of consecutive sectors its data takes, and likewise for the
+   free space. */
+void
+fsutil_layout (char **argv)
+{
+  const char *file_name = argv[1];
+  struct file *file;
+  size_t sector_cnt, run_cnt;
+
+  printf ("Layout of '%s':\n", file_name);
+  file = filesys_open (file_name);
+  if (file == NULL)
+    PANIC ("%s: open failed", file_name);
+  inode_count_runs (file_get_inode (file), &sector_cnt, &run_cnt);
+  printf ("%s: %"PROTd" bytes, %zu sectors in %zu runs\n", file_name,
+          file_length (file), sector_cnt, run_cnt);
+  file_close (file);
+
+  free_map_count (&sector_cnt, &run_cnt);
+  printf ("free space: %zu sectors in %zu runs\n", sector_cnt, run_cnt);
+}
+
 /* Deletes file ARGV[1]. */
 void
 fsutil_rm (char **argv) 
@@ -1,6 +1,8 @@
 #include "filesys/inode.h"
 #include <list.h>
 #include <debug.h>
+#include <hash.h>
+#include <stdio.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
@@ -9,65 +11,603 @@
 #include "threads/malloc.h"
 
 
+/* Returns entry OFS of index block IDX of INODE's block map,
+   which is a copy of the index block in SECTOR.  The copy is
+   made on first use and kept while INODE is open, so later
+   lookups cost neither a cache access nor an allocation.  If
+   memory is short, reads the entry through the cache instead.
+   Returns 0, a hole, if SECTOR is 0. */
+static block_sector_t
+map_lookup (struct inode *inode, int idx, block_sector_t sector, int ofs)
+{
+  struct inode_indirect *block = inode->map[idx];
+
+  if (sector == 0)
+    return 0;
+  if (block == NULL)
+    {
+      block = malloc (sizeof *block);
+      if (block == NULL)
+        {
+          struct cache_entry *entry;
+          const struct inode_indirect *indirect_parts
+            = cache_pin_read (sector, CACHE_META, &entry);
+          block_sector_t result = indirect_parts->indirect_inode[ofs];
+          cache_unpin (entry);
+          return result;
+        }
+      cache_read_sector (sector, CACHE_META, block, 0, BLOCK_SECTOR_SIZE);
+      inode->map[idx] = block;
+    }
+  return block->indirect_inode[ofs];
+}
+
+/* Frees INODE's block map. */
+static void
+map_free (struct inode *inode)
+{
+  int idx;
+
+  for (idx = 0; idx < MAP_BLOCK_CNT; idx++)
+    {
+      free (inode->map[idx]);
+      inode->map[idx] = NULL;
+    }
+}
+
+/* Allocates a sector, preferably at or after GOAL, fills it
+   with zeros cached as TYPE and stores it in *SECTORP.  Returns
+   false if the disk is full. */
+static bool
+sector_allocate (block_sector_t goal, block_sector_t *sectorp,
+                 enum cache_type type)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (!free_map_allocate_near (goal, 1, sectorp))
+    return false;
+  cache_write (*sectorp, type, zeros, 0, BLOCK_SECTOR_SIZE);
+  return true;
+}
+
+/* Makes SECTOR entry OFS of the index block in *INDEXP, which
+   is block IDX of INODE's block map.  If *INDEXP is 0,
+   allocates the index block first, near the sector SECTOR
+   names, and the caller must store the new *INDEXP.  Keeps the block map up to date.
+   Returns false if the disk is full. */
+static bool
+map_set (struct inode *inode, int idx, block_sector_t *indexp, int ofs,
+         block_sector_t sector)
+{
+  struct inode_indirect *block;
+  struct cache_entry *entry;
+
+  if (*indexp == 0
+      && !sector_allocate (sector & ~SECTOR_UNWRITTEN, indexp, CACHE_META))
+    return false;
+  block = cache_pin_write (*indexp, CACHE_META, &entry);
+  block->indirect_inode[ofs] = sector;
+  cache_unpin (entry);
+  if (inode->map[idx] != NULL)
+    inode->map[idx]->indirect_inode[ofs] = sector;
+  return true;
+}
+
+/* Adds index block SECTOR, unless it is 0, to BATCH along with
+   the sectors it points to, which are index blocks of the same
+   kind with one LEVEL less if LEVEL is above 1.  Holes are
+   skipped. */
+static void
+index_release (block_sector_t sector, int level, struct free_map_batch *batch)
+{
+  struct inode_indirect block;
+  int i;
+
+  if (sector == 0)
+    return;
+  cache_read_sector (sector, CACHE_META, &block, 0, BLOCK_SECTOR_SIZE);
+  for (i = 0; i < INDIRECT_BLOCK; i++)
+    if (block.indirect_inode[i] == 0)
+      continue;
+    else if (level > 1)
+      index_release (block.indirect_inode[i], level - 1, batch);
+    else
+      free_map_batch_add (batch, block.indirect_inode[i] & ~SECTOR_UNWRITTEN,
+                          1);
+  free_map_batch_add (batch, sector, 1);
+}
+
+/* Adds the data sectors and index blocks of DISK_INODE, which
+   has the INODE_BLOCKS layout, to BATCH. */
+static void
+blocks_release (const struct inode_disk *disk_inode,
+                struct free_map_batch *batch)
+{
+  int i;
+
+  for (i = 0; i < DIRECT_BLOCK; i++)
+    if (disk_inode->direct_part[i] != 0)
+      free_map_batch_add (batch,
+                          disk_inode->direct_part[i] & ~SECTOR_UNWRITTEN, 1);
+  index_release (disk_inode->indirect_part, 1, batch);
+  index_release (disk_inode->double_indirect_part, 2, batch);
+}
+
+/* Returns the sector holding sector IDX of the data of
+   DISK_INODE, which has the INODE_EXTENTS layout, or -1 if
+   there is none.  If RUN is nonnull, stores in *RUN the number
+   of sectors from there to the end of the extent, which are
+   contiguous on disk. */
+static block_sector_t
+extent_lookup (const struct inode_disk *disk_inode, size_t idx, size_t *run)
+{
+  const struct inode_extent *block = NULL;
+  struct cache_entry *entry = NULL;
+  block_sector_t sector = -1;
+  size_t i;
+
+  for (i = 0; i < disk_inode->extent_cnt; i++)
+    {
+      const struct inode_extent *e;
+      if (i < INLINE_EXTENTS)
+        e = &disk_inode->extents[i];
+      else
+        {
+          if (block == NULL)
+            block = cache_pin_read (disk_inode->extent_block, CACHE_META,
+                                    &entry);
+          e = &block[i - INLINE_EXTENTS];
+        }
+      if (idx < e->length)
+        {
+          sector = e->start + idx;
+          if (run != NULL)
+            *run = e->length - idx;
+          break;
+        }
+      idx -= e->length;
+    }
+  if (entry != NULL)
+    cache_unpin (entry);
+  return sector;
+}
+
+/* Returns the number of sectors in the extents of DISK_INODE. */
+static size_t
+extent_total (const struct inode_disk *disk_inode)
+{
+  const struct inode_extent *block = NULL;
+  struct cache_entry *entry = NULL;
+  size_t total = 0;
+  size_t i;
+
+  for (i = 0; i < disk_inode->extent_cnt; i++)
+    {
+      if (i < INLINE_EXTENTS)
+        total += disk_inode->extents[i].length;
+      else
+        {
+          if (block == NULL)
+            block = cache_pin_read (disk_inode->extent_block, CACHE_META,
+                                    &entry);
+          total += block[i - INLINE_EXTENTS].length;
+        }
+    }
+  if (entry != NULL)
+    cache_unpin (entry);
+  return total;
+}
+
+/* Appends the CNT sectors starting at START to the extents of
+   DISK_INODE, merging them into the last extent if they follow
+   it on disk.  Returns false if all the extents are in use or
+   the extent block cannot be allocated. */
+static bool
+extent_append (struct inode_disk *disk_inode, block_sector_t start,
+               size_t cnt)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  struct inode_extent *block = NULL;
+  struct cache_entry *entry = NULL;
+  struct inode_extent *last = NULL;
+  size_t n = disk_inode->extent_cnt;
+
+  /* Find the last extent. */
+  if (n > INLINE_EXTENTS)
+    {
+      block = cache_pin_write (disk_inode->extent_block, CACHE_META, &entry);
+      last = &block[n - 1 - INLINE_EXTENTS];
+    }
+  else if (n > 0)
+    last = &disk_inode->extents[n - 1];
+
+  if (last != NULL && last->start + last->length == start)
+    last->length += cnt;
+  else if (n < INLINE_EXTENTS)
+    {
+      disk_inode->extents[n].start = start;
+      disk_inode->extents[n].length = cnt;
+      disk_inode->extent_cnt++;
+    }
+  else if (n < MAX_EXTENTS)
+    {
+      if (block == NULL)
+        {
+          if (!free_map_allocate (1, &disk_inode->extent_block))
+            return false;
+          cache_write (disk_inode->extent_block, CACHE_META, zeros, 0,
+                       BLOCK_SECTOR_SIZE);
+          block = cache_pin_write (disk_inode->extent_block, CACHE_META,
+                                   &entry);
+        }
+      block[n - INLINE_EXTENTS].start = start;
+      block[n - INLINE_EXTENTS].length = cnt;
+      disk_inode->extent_cnt++;
+    }
+  else
+    {
+      if (entry != NULL)
+        cache_unpin (entry);
+      return false;
+    }
+  if (entry != NULL)
+    cache_unpin (entry);
+  return true;
+}
+
+/* Extends DISK_INODE, which has the INODE_EXTENTS layout, to
+   SECTOR_CNT sectors of zeros cached as TYPE, taking the
+   longest free runs the free map has, preferably right after
+   the last extent.  Returns false if the
+   disk or the extents run out, in which case DISK_INODE keeps
+   whatever it got. */
+static bool
+extent_grow (struct inode_disk *disk_inode, size_t sector_cnt,
+             enum cache_type type)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  size_t have = extent_total (disk_inode);
+
+  while (have < sector_cnt)
+    {
+      size_t cnt = sector_cnt - have;
+      block_sector_t goal = 0;
+      block_sector_t start;
+      size_t i;
+
+      if (have > 0)
+        goal = extent_lookup (disk_inode, have - 1, NULL) + 1;
+      while (!free_map_allocate_near (goal, cnt, &start))
+        {
+          if (cnt == 1)
+            return false;
+          cnt /= 2;
+        }
+      if (!extent_append (disk_inode, start, cnt))
+        {
+          free_map_release (start, cnt);
+          return false;
+        }
+      for (i = 0; i < cnt; i++)
+        cache_write (start + i, type, zeros, 0, BLOCK_SECTOR_SIZE);
+      have += cnt;
+    }
+  return true;
+}
+
+/* Adds the data sectors and the extent block of DISK_INODE,
+   which has the INODE_EXTENTS layout, to BATCH. */
+static void
+extent_release (const struct inode_disk *disk_inode,
+                struct free_map_batch *batch)
+{
+  struct inode_extent block[BLOCK_EXTENTS];
+  size_t i;
+
+  if (disk_inode->extent_cnt > INLINE_EXTENTS)
+    cache_read_sector (disk_inode->extent_block, CACHE_META, block, 0,
+                       BLOCK_SECTOR_SIZE);
+  for (i = 0; i < disk_inode->extent_cnt; i++)
+    {
+      const struct inode_extent *e = (i < INLINE_EXTENTS
+                                      ? &disk_inode->extents[i]
+                                      : &block[i - INLINE_EXTENTS]);
+      free_map_batch_add (batch, e->start, e->length);
+    }
+  if (disk_inode->extent_block != 0)
+    free_map_batch_add (batch, disk_inode->extent_block, 1);
+}
+
+/* Returns entry IDX of the block map of INODE, which has the
+   INODE_BLOCKS layout: a sector, 0 for a hole, or a sector
+   reserved with SECTOR_UNWRITTEN set.  Returns -1 if IDX is
+   past the largest file. */
+static block_sector_t
+block_entry (struct inode *inode, size_t idx)
+{
+  /* count the offset_th block of the pos, stored in offset. */
+  int offset = idx;
+    
+  /* If in direct part, */
+  if (offset < DIRECT_BLOCK)
+    /* directly fetch the data from the direct array and return. */
+    return inode->data.direct_part[offset];
+    
+  /* If in indirect part, look it up in the block map. */
+  else if (offset < DIRECT_BLOCK + INDIRECT_BLOCK)
+    return map_lookup (inode, MAP_INDIRECT, inode->data.indirect_part,
+                       offset - DIRECT_BLOCK);
+    
+  /* If in double direct part, */
+  else if (offset < DIRECT_BLOCK + INDIRECT_BLOCK + DOUBLE_INDIRECT){
+    /* first find the entry of the first level, */
+    int indirect_offset = (offset - DIRECT_BLOCK -  INDIRECT_BLOCK) 
+                          / INDIRECT_BLOCK;
+    block_sector_t sector = map_lookup (inode, MAP_DOUBLE,
+                                        inode->data.double_indirect_part,
+                                        indirect_offset);
+    /* then the entry of the second level. */
+    int double_offset = (offset - DIRECT_BLOCK - INDIRECT_BLOCK) 
+                        % INDIRECT_BLOCK;
+    return map_lookup (inode, MAP_DOUBLE + 1 + indirect_offset, sector,
+                       double_offset);
+  }
+  return -1;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   POS, or 0 if POS lies in a hole, which reads as zeros, or in
+   inline data. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
-  if (pos < inode->data.length){
-    /* count the offset_th block of the pos, stored in offset. */
-    int offset = pos / BLOCK_SECTOR_SIZE;
-    
-    /* If in direct part, */
-    if (offset < DIRECT_BLOCK)
-      /* directly fetch the data from the direct array and return. */
-      return inode->data.direct_part[offset];
-    
-    /* If in direct part, */
-    else if (offset < DIRECT_BLOCK + INDIRECT_BLOCK){
-      /* fetch the entry of the indirect part, and read sector from it, */
-      struct inode_indirect *indirect_parts = 
-                              malloc(sizeof(struct inode_indirect));
-      cache_read_sector(inode->data.indirect_part, 
-                        indirect_parts, 0, BLOCK_SECTOR_SIZE);
-      /* return sector that matches the offset position. */
-      return indirect_parts->indirect_inode[offset - DIRECT_BLOCK];
+  if (inode->data.layout == INODE_INLINE)
+    return pos < inode->data.length ? 0 : (block_sector_t) -1;
+  if (inode->data.layout == INODE_EXTENTS)
+    return (pos < inode->data.length
+            ? extent_lookup (&inode->data, pos / BLOCK_SECTOR_SIZE, NULL)
+            : (block_sector_t) -1);
+  if (pos < inode->data.length)
+    {
+      block_sector_t sector = block_entry (inode, pos / BLOCK_SECTOR_SIZE);
+      return (sector & SECTOR_UNWRITTEN) == 0 ? sector : 0;
     }
-    
-    /* If in double direct part, */
-    else if (offset < DIRECT_BLOCK + INDIRECT_BLOCK + DOUBLE_INDIRECT){
-      struct inode_indirect *indirect_parts = 
-                            malloc(sizeof(struct inode_indirect));
-      /* first find the entry of the first level, and load it from cache, */
-      cache_read_sector (inode->data.double_indirect_part, 
-                        indirect_parts, 0, BLOCK_SECTOR_SIZE);
-      /* then find the entry of the second level, and load it from cache, */
-      int indirect_offset = (offset - DIRECT_BLOCK -  INDIRECT_BLOCK) 
-                            / INDIRECT_BLOCK;
-      cache_read_sector (indirect_parts->indirect_inode[indirect_offset], 
-                        indirect_parts, 0, BLOCK_SECTOR_SIZE);
-      /* finally return sector that matches the offset position. */
-      int double_offset = (offset - DIRECT_BLOCK - INDIRECT_BLOCK) 
-                          % INDIRECT_BLOCK;
-      return indirect_parts->indirect_inode[double_offset];
+  return -1;
+}
+
+/* Makes SECTOR sector IDX of the data of INODE, which has the
+   INODE_BLOCKS layout, allocating index blocks as needed.  If
+   UNWRITTEN, SECTOR is only reserved and keeps what it holds;
+   otherwise it is filled with zeros cached as TYPE.  Leaves
+   writing the inode sector to the caller, but notes that the
+   block map changed, so that the next sync writes it.  Returns
+   false if the disk is full. */
+static bool
+block_set (struct inode *inode, size_t idx, block_sector_t sector,
+           enum cache_type type, bool unwritten)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  struct inode_disk *data = &inode->data;
+  block_sector_t entry = unwritten ? sector | SECTOR_UNWRITTEN : sector;
+  block_sector_t second;
+  int top;
+
+  if (!unwritten)
+    cache_write (sector, type, zeros, 0, BLOCK_SECTOR_SIZE);
+  inode->map_changed = true;
+  if (idx < DIRECT_BLOCK)
+    {
+      data->direct_part[idx] = entry;
+      return true;
     }
-  }
-  else
-    return -1;
+  idx -= DIRECT_BLOCK;
+  if (idx < INDIRECT_BLOCK)
+    return map_set (inode, MAP_INDIRECT, &data->indirect_part, idx, entry);
+
+  /* The top block points to index blocks of its own. */
+  idx -= INDIRECT_BLOCK;
+  top = idx / INDIRECT_BLOCK;
+  second = map_lookup (inode, MAP_DOUBLE, data->double_indirect_part, top);
+  if (second == 0)
+    {
+      if (!sector_allocate (sector, &second, CACHE_META))
+        return false;
+      if (!map_set (inode, MAP_DOUBLE, &data->double_indirect_part, top,
+                    second))
+        {
+          free_map_release (second, 1);
+          return false;
+        }
+    }
+  return map_set (inode, MAP_DOUBLE + 1 + top, &second, idx % INDIRECT_BLOCK,
+                  entry);
 }
 
-/* List of open inodes, so that opening a single inode twice
+/* Fills up to CNT sectors of the hole at sector IDX of the
+   data of INODE, which has the INODE_BLOCKS layout, with one
+   run of new sectors, placed right after the sector before IDX
+   if that is free, so that a file written in order stays
+   contiguous.  The sectors are set with block_set() as TYPE
+   and UNWRITTEN.  Returns the number of sectors filled, which
+   is 0 if the disk is full. */
+static size_t
+blocks_fill (struct inode *inode, size_t idx, size_t cnt,
+             enum cache_type type, bool unwritten)
+{
+  block_sector_t goal = inode->sector + 1;
+  block_sector_t start;
+  size_t i;
+
+  ASSERT (inode->data.layout == INODE_BLOCKS);
+  if (idx >= MAX_BLOCK_SECTORS)
+    return 0;
+  if (cnt > MAX_BLOCK_SECTORS - idx)
+    cnt = MAX_BLOCK_SECTORS - idx;
+  for (i = 1; i < cnt; i++)
+    if (block_entry (inode, idx + i) != 0)
+      break;
+  cnt = i;
+  if (idx > 0)
+    {
+      block_sector_t prev = block_entry (inode, idx - 1) & ~SECTOR_UNWRITTEN;
+      if (prev != 0)
+        goal = prev + 1;
+    }
+
+  while (!free_map_allocate_near (goal, cnt, &start))
+    {
+      if (cnt == 1)
+        return 0;
+      cnt /= 2;
+    }
+  for (i = 0; i < cnt; i++)
+    if (!block_set (inode, idx + i, start + i, type, unwritten))
+      {
+        free_map_release (start + i, cnt - i);
+        break;
+      }
+  cache_write (inode->sector, CACHE_META, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  return i;
+}
+
+/* Like byte_to_sector(), but makes the sector at POS, which
+   only the INODE_BLOCKS layout can lack, ready to be written
+   as TYPE.  A hole is filled with up to CNT sectors of zeros
+   by blocks_fill(), and a sector reserved by inode_allocate()
+   is zeroed in the cache.  Returns 0 if the disk is full. */
+static block_sector_t
+byte_to_sector_alloc (struct inode *inode, off_t pos, size_t cnt,
+                      enum cache_type type)
+{
+  size_t idx = pos / BLOCK_SECTOR_SIZE;
+  block_sector_t entry;
+
+  ASSERT (inode->data.layout == INODE_BLOCKS);
+  if (idx >= MAX_BLOCK_SECTORS)
+    return 0;
+  entry = block_entry (inode, idx);
+  if (entry & SECTOR_UNWRITTEN)
+    {
+      entry &= ~SECTOR_UNWRITTEN;
+      if (!block_set (inode, idx, entry, type, false))
+        return 0;
+      if (idx < DIRECT_BLOCK)
+        cache_write (inode->sector, CACHE_META, &inode->data, 0,
+                     BLOCK_SECTOR_SIZE);
+      return entry;
+    }
+  if (blocks_fill (inode, idx, cnt, type, false) == 0)
+    return 0;
+  return block_entry (inode, idx);
+}
+
+/* Like byte_to_sector(), but also stores in *RUN the number of
+   sectors from there on that are contiguous on disk, which is
+   1 unless INODE has the INODE_EXTENTS layout.  The run may
+   reach past the end of the file. */
+static block_sector_t
+byte_to_run (struct inode *inode, off_t pos, size_t *run)
+{
+  *run = 1;
+  if (inode->data.layout == INODE_EXTENTS && pos < inode->data.length)
+    return extent_lookup (&inode->data, pos / BLOCK_SECTOR_SIZE, run);
+  return byte_to_sector (inode, pos);
+}
+
+/* Returns how the cache should treat the data of the inode
+   in SECTOR holding DISK_INODE.  Directories and the free map
+   are metadata, re-read on every lookup and allocation. */
+static enum cache_type
+data_type (block_sector_t sector, const struct inode_disk *disk_inode)
+{
+  return (disk_inode->dir_or_file || sector == FREE_MAP_SECTOR
+          ? CACHE_META : CACHE_DATA);
+}
+
+/* Returns how the cache should treat the data of INODE. */
+static enum cache_type
+inode_data_type (const struct inode *inode)
+{
+  return data_type (inode->sector, &inode->data);
+}
+
+/* Open inodes by sector, so that opening a single inode twice
    returns the same `struct inode'. */
-static struct list open_inodes;
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+static struct condition open_loaded;    /* An inode was read in. */
+
+/* Statistics of open_inodes. */
+static size_t open_peak;                /* Most inodes open at once. */
+static long long open_lookup_cnt;       /* Calls to inode_open(). */
+static long long open_hit_cnt;          /* Of those, already open. */
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
+static off_t write_at_locked (struct inode *, const void *, off_t, off_t);
+static bool inline_migrate (struct inode *);
+
+/* Layout of new inodes. */
+static enum inode_layout new_layout;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("can't allocate open inode table");
+  lock_init (&open_inodes_lock);
+  cond_init (&open_loaded);
+  new_layout = INODE_BLOCKS;
+}
+
+/* Returns a hash of the sector of the inode holding E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Returns true if the inode holding A comes before the one
+   holding B, by sector. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
+
+/* Prints statistics of the open inode table. */
+void
+inode_print_stats (void)
+{
+  size_t bucket_cnt, longest;
+
+  lock_acquire (&open_inodes_lock);
+  bucket_cnt = hash_buckets (&open_inodes, &longest);
+  printf ("Inodes: %zu open (peak %zu), %zu buckets, longest chain %zu\n",
+          hash_size (&open_inodes), open_peak, bucket_cnt, longest);
+  lock_release (&open_inodes_lock);
+  printf ("Inodes: %lld opens, %lld already open\n",
+          open_lookup_cnt, open_hit_cnt);
+}
+
+/* Makes inodes created from now on use LAYOUT. */
+void
+inode_set_layout (enum inode_layout layout)
+{
+  new_layout = layout;
+}
+
+/* Returns the layout of INODE. */
+enum inode_layout
+inode_get_layout (const struct inode *inode)
+{
+  return inode->data.layout;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -86,7 +626,7 @@ inode_create (block_sector_t sector, off_t length,
 
   /* If this assertion fails, the inode structure is not exactly
      one sector in size, and you should fix that. */
-  // ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
@@ -97,55 +637,96 @@ inode_create (block_sector_t sector, off_t length,
       disk_inode->magic = INODE_MAGIC;
       disk_inode->dir_or_file = dir_or_file;
       disk_inode->parent = parent;
+      enum cache_type type = data_type (sector, disk_inode);
       struct inode_indirect inode_indirect;
+      disk_inode->layout = new_layout;
+
+      /* A small file keeps its data in the inode sector until it
+         outgrows it.  Its zeros are already there. */
+      if (type == CACHE_DATA && length <= (off_t) INLINE_SIZE)
+        {
+          disk_inode->layout = INODE_INLINE;
+          cache_write (sector, CACHE_META, disk_inode, 0, BLOCK_SECTOR_SIZE);
+          free (disk_inode);
+          return true;
+        }
+
+      if (disk_inode->layout == INODE_EXTENTS)
+        {
+          success = extent_grow (disk_inode, sectors, type);
+          if (success)
+            cache_write (sector, CACHE_META, disk_inode, 0,
+                         BLOCK_SECTOR_SIZE);
+          else
+            {
+              struct free_map_batch batch;
+              free_map_batch_init (&batch);
+              extent_release (disk_inode, &batch);
+              free_map_batch_flush (&batch);
+            }
+          free (disk_inode);
+          return success;
+        }
+
+      /* File data starts out as one hole, filled in as it is
+         written, so creating a file of any size writes only its
+         inode.  Directories and the free map, which is written
+         while sectors are being allocated, get their sectors
+         now. */
+      if (type == CACHE_DATA)
+        {
+          cache_write (sector, CACHE_META, disk_inode, 0, BLOCK_SECTOR_SIZE);
+          free (disk_inode);
+          return true;
+        }
 
       // proj4
       for (int i = 0; i < DIRECT_BLOCK; i++){
         if (i == sectors){
           // 1. if direct
-          cache_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+          cache_write(sector, CACHE_META, disk_inode, 0, BLOCK_SECTOR_SIZE);
           return true;
         }
         if (disk_inode->direct_part[i] == 0){
           /* if the sectors is not allocated, fill it with zeros. */
-          free_map_allocate(1, &disk_inode->direct_part[i]);
-          cache_write(disk_inode->direct_part[i], 
+          free_map_allocate_near(sector, 1, &disk_inode->direct_part[i]);
+          cache_write(disk_inode->direct_part[i], type,
                       zeros, 0, BLOCK_SECTOR_SIZE);
         }
       }
       // for indirect
       if (disk_inode->indirect_part == 0){
         /* if the sectors is not allocated, fill it with zeros. */
-        free_map_allocate(1, &disk_inode->indirect_part);
-        cache_write(disk_inode->indirect_part, 
+        free_map_allocate_near(sector, 1, &disk_inode->indirect_part);
+        cache_write(disk_inode->indirect_part, CACHE_META,
                     zeros, 0, BLOCK_SECTOR_SIZE);
       }
-      cache_read_sector(disk_inode->indirect_part, 
+      cache_read_sector(disk_inode->indirect_part, CACHE_META,
                         &inode_indirect, 0, BLOCK_SECTOR_SIZE);
       for (int i = 0; i < sectors - DIRECT_BLOCK; i++){
         if (inode_indirect.indirect_inode[i] == 0){
           /* if the sectors is not allocated, fill it with zeros. */
-          free_map_allocate(1, &inode_indirect.indirect_inode[i]);
-          cache_write(inode_indirect.indirect_inode[i], 
+          free_map_allocate_near(sector, 1, &inode_indirect.indirect_inode[i]);
+          cache_write(inode_indirect.indirect_inode[i], type,
                       zeros, 0, BLOCK_SECTOR_SIZE);
         }
       }
-      cache_write(disk_inode->indirect_part, 
+      cache_write(disk_inode->indirect_part, CACHE_META,
                   &inode_indirect, 0, BLOCK_SECTOR_SIZE);
       // 2. if indirect
       if (sectors - DIRECT_BLOCK < INDIRECT_BLOCK){
-        cache_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+        cache_write(sector, CACHE_META, disk_inode, 0, BLOCK_SECTOR_SIZE);
         return true;
       }
       // 3. if double indirect
       if (sectors - DIRECT_BLOCK - INDIRECT_BLOCK < DOUBLE_INDIRECT){
         if (disk_inode->double_indirect_part == 0){
           /* if the sectors is not allocated, fill it with zeros. */
-          free_map_allocate(1, &disk_inode->double_indirect_part);
-          cache_write(disk_inode->double_indirect_part, 
+          free_map_allocate_near(sector, 1, &disk_inode->double_indirect_part);
+          cache_write(disk_inode->double_indirect_part, CACHE_META,
                       zeros, 0, BLOCK_SECTOR_SIZE);
         }
-        cache_read_sector(disk_inode->double_indirect_part, 
+        cache_read_sector(disk_inode->double_indirect_part, CACHE_META,
                           &inode_indirect, 0, BLOCK_SECTOR_SIZE);
         int length = sectors - DIRECT_BLOCK - INDIRECT_BLOCK;
         int offset = length / INDIRECT_BLOCK + 1;
@@ -153,26 +734,27 @@ inode_create (block_sector_t sector, off_t length,
           struct inode_indirect temp;
           if (inode_indirect.indirect_inode[i] == 0){
             /* if the sectors is not allocated, fill it with zeros. */
-            free_map_allocate(1, &inode_indirect.indirect_inode[i]);
-            cache_write(inode_indirect.indirect_inode[i], 
+            free_map_allocate_near(sector, 1,
+                                   &inode_indirect.indirect_inode[i]);
+            cache_write(inode_indirect.indirect_inode[i], CACHE_META,
                         zeros, 0, BLOCK_SECTOR_SIZE);
           }
-          cache_read_sector(inode_indirect.indirect_inode[i], 
+          cache_read_sector(inode_indirect.indirect_inode[i], CACHE_META,
                             &temp, 0, BLOCK_SECTOR_SIZE);
           for (int i = 0; i < length; i++){
             if (temp.indirect_inode[i] == 0){
               /* if the sectors is not allocated, fill it with zeros. */
-              free_map_allocate(1, &temp.indirect_inode[i]);
-              cache_write(temp.indirect_inode[i], 
+              free_map_allocate_near(sector, 1, &temp.indirect_inode[i]);
+              cache_write(temp.indirect_inode[i], type,
                           zeros, 0, BLOCK_SECTOR_SIZE);
             }
           }
-          cache_write(inode_indirect.indirect_inode[i], 
+          cache_write(inode_indirect.indirect_inode[i], CACHE_META,
                       &temp, 0, BLOCK_SECTOR_SIZE);
         }
-        cache_write(disk_inode->double_indirect_part, 
+        cache_write(disk_inode->double_indirect_part, CACHE_META,
                     &inode_indirect, 0, BLOCK_SECTOR_SIZE);
-        cache_write(sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+        cache_write(sector, CACHE_META, disk_inode, 0, BLOCK_SECTOR_SIZE);
         return true;
       }
     }
@@ -187,33 +769,59 @@ inode_create (block_sector_t sector, off_t length,
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  key.sector = sector;
+  lock_acquire (&open_inodes_lock);
+  open_lookup_cnt++;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      open_hit_cnt++;
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      while (inode->loading)
+        cond_wait (&open_loaded, &open_inodes_lock);
+      lock_release (&open_inodes_lock);
+      return inode;
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  The inode goes in the table marked as loading
+     and is read after the table is unlocked, so that a slow read
+     does not hold up opens of other inodes.  Others who find it
+     meanwhile wait until it is complete. */
   inode->sector = sector;
+  hash_insert (&open_inodes, &inode->elem);
+  if (hash_size (&open_inodes) > open_peak)
+    open_peak = hash_size (&open_inodes);
   inode->open_cnt = 1;
+  inode->loading = true;
+  lock_init (&inode->lock);
+  lock_init (&inode->dir_lock);
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  cache_read_sector (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  inode->synced_length = -1;
+  inode->map_changed = false;
+  memset (inode->map, 0, sizeof inode->map);
+  lock_release (&open_inodes_lock);
+
+  cache_read_sector (inode->sector, CACHE_META, &inode->data, 0,
+                     BLOCK_SECTOR_SIZE);
+  lock_acquire (&open_inodes_lock);
+  inode->loading = false;
+  cond_broadcast (&open_loaded, &open_inodes_lock);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -222,7 +830,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -243,61 +855,35 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.  Once out of
+     the table, INODE is ours alone. */
+  lock_acquire (&open_inodes_lock);
+  if (--inode->open_cnt > 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
-      if (inode->removed) 
-        {
-          free_map_release (inode->sector, 1);
-          struct inode_indirect inode_indirect;
-          size_t sectors = bytes_to_sectors(inode->data.length);
-          /* Firstly, free the direct part. */
-          for (int i = 0; i < DIRECT_BLOCK; ++i){
-            if (i == sectors){
-              /* If direct, return immdiately after freeing sectors. */
-              free(inode);
-              return;
-            }
-            /* free the first i sectors. */
-            free_map_release(inode->data.direct_part[i], 1);
-          }
-          
-          /* Secondly, load indirect part and free the indirect part. */
-          cache_read_sector(inode->data.indirect_part, 
-                            &inode_indirect, 0, BLOCK_SECTOR_SIZE);
-          for (int i = 0; i < INDIRECT_BLOCK; i++)
-            /* free the indirect sectors. */
-            free_map_release(inode_indirect.indirect_inode[i], 1);
-          /* If indirect, return immdiately after freeing sectors. */
-          if (sectors - DIRECT_BLOCK < INDIRECT_BLOCK){
-            free(inode);
-            return;
-          }
-          
-          /* Thirdly, load double indirect part and free. */
-          cache_read_sector(inode->data.double_indirect_part, 
-                            &inode_indirect, 0, BLOCK_SECTOR_SIZE);
-          int length = sectors - DIRECT_BLOCK - INDIRECT_BLOCK;
-          int offset = length / INDIRECT_BLOCK + 1;
-          /* free the whole offset parts of the first level of the 
-             double indirect part. */
-          for (int i = 0; i < offset; i++){
-            /* find the entry of the second level, and load it from cache */
-            struct inode_indirect temp_block;
-            cache_read_sector(inode_indirect.indirect_inode[i], 
-                              &temp_block, 0, BLOCK_SECTOR_SIZE);
-            for (int i = 0; i < INDIRECT_BLOCK; i++)
-              /* free each second-level entry. */
-              free_map_release(temp_block.indirect_inode[i], 1);
-          }
-        }
+      lock_release (&open_inodes_lock);
+      return;
+    }
+  hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+  map_free (inode);
 
-      free (inode); 
+  /* Deallocate blocks if removed, gathering them into runs so
+     that the free map is rewritten once rather than once per
+     sector. */
+  if (inode->removed)
+    {
+      struct free_map_batch batch;
+
+      free_map_batch_init (&batch);
+      free_map_batch_add (&batch, inode->sector, 1);
+      if (inode->data.layout == INODE_EXTENTS)
+        extent_release (&inode->data, &batch);
+      else if (inode->data.layout == INODE_BLOCKS)
+        blocks_release (&inode->data, &batch);
+      free_map_batch_flush (&batch);
     }
+
+  free (inode); 
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -306,7 +892,31 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+  lock_acquire (&inode->lock);
   inode->removed = true;
+  lock_release (&inode->lock);
+}
+
+/* Frees the inode in SECTOR and its blocks.  For an inode that
+   was just created and is not open, such as one whose directory
+   entry could not be added; unlike opening and removing it, this
+   cannot fail for want of memory. */
+void
+inode_release (block_sector_t sector)
+{
+  struct free_map_batch batch;
+  struct cache_entry *entry;
+  const struct inode_disk *disk_inode
+    = cache_pin_read (sector, CACHE_META, &entry);
+
+  free_map_batch_init (&batch);
+  free_map_batch_add (&batch, sector, 1);
+  if (disk_inode->layout == INODE_EXTENTS)
+    extent_release (disk_inode, &batch);
+  else if (disk_inode->layout == INODE_BLOCKS)
+    blocks_release (disk_inode, &batch);
+  cache_unpin (entry);
+  free_map_batch_flush (&batch);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
@@ -319,14 +929,35 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
 
+  /* An inline inode never goes back to being inline, so only
+     the check and the copy need the lock. */
+  lock_acquire (&inode->lock);
+  if (inode->data.layout == INODE_INLINE)
+    {
+      if (offset < inode->data.length)
+        {
+          bytes_read = inode->data.length - offset;
+          if (bytes_read > size)
+            bytes_read = size;
+          memcpy (buffer, inode->data.inline_data + offset, bytes_read);
+        }
+      lock_release (&inode->lock);
+      return bytes_read;
+    }
+  lock_release (&inode->lock);
+
   while (size > 0) 
     {
-      /* Disk sector to read, starting byte offset within sector. */
+      /* Disk sector to read, starting byte offset within sector.
+         The inode is locked only while mapping, so that readers
+         of one file copy out of the cache in parallel. */
+      lock_acquire (&inode->lock);
       block_sector_t sector_idx = byte_to_sector (inode, offset);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
       off_t inode_left = inode_length (inode) - offset;
+      lock_release (&inode->lock);
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -334,8 +965,11 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       int chunk_size = size < min_left ? size : min_left;
       if (chunk_size <= 0)
         break;
-      cache_read_sector (sector_idx, buffer + bytes_read, 
-                        sector_ofs, chunk_size);
+      if (sector_idx == 0)
+        memset (buffer + bytes_read, 0, chunk_size);
+      else
+        cache_read_sector (sector_idx, inode_data_type (inode),
+                           buffer + bytes_read, sector_ofs, chunk_size);
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
@@ -346,59 +980,356 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   return bytes_read;
 }
 
+/* Pins the sector of INODE holding byte OFFSET in the cache and
+   returns a pointer to that byte, to be released by passing
+   *ENTRYP to cache_unpin().  Sets *AVAIL to the number of bytes
+   readable through the pointer, up to the end of the sector or
+   of the file.  Returns a null pointer if OFFSET is at or past
+   end of file.  A hole reads through a sector of zeros, and
+   inline data in place in INODE; neither needs a pin, and
+   *ENTRYP is set to a null pointer. */
+const void *
+inode_pin_read (struct inode *inode, off_t offset, off_t *avail,
+                struct cache_entry **entryp)
+{
+  block_sector_t sector_idx;
+  int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+  off_t inode_left;
+  int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
+  const uint8_t *data;
+
+  lock_acquire (&inode->lock);
+  sector_idx = byte_to_sector (inode, offset);
+  inode_left = inode_length (inode) - offset;
+  lock_release (&inode->lock);
+  if ((int) sector_idx == -1)
+    return NULL;
+  *avail = inode_left < sector_left ? inode_left : sector_left;
+  if (sector_idx == 0 && inode->data.layout == INODE_INLINE)
+    {
+      *entryp = NULL;
+      return inode->data.inline_data + offset;
+    }
+  if (sector_idx == 0)
+    {
+      static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+      *entryp = NULL;
+      return zeros + sector_ofs;
+    }
+  data = cache_pin_read (sector_idx, inode_data_type (inode), entryp);
+  return data + sector_ofs;
+}
+
+/* Asks the cache to read ahead the SECTOR_CNT sectors of
+   INODE starting at byte offset OFFSET, stopping at end of
+   file.  Holes are skipped. */
+void
+inode_read_ahead (struct inode *inode, off_t offset, int sector_cnt)
+{
+  lock_acquire (&inode->lock);
+  while (sector_cnt > 0 && offset < inode_length (inode))
+    {
+      size_t run;
+      block_sector_t sector_idx = byte_to_run (inode, offset, &run);
+      if ((int) sector_idx == -1)
+        break;
+      if (sector_idx == 0)
+        {
+          sector_cnt--;
+          offset += BLOCK_SECTOR_SIZE;
+          continue;
+        }
+      /* Request the contiguous sectors without looking each up. */
+      for (; run > 0 && sector_cnt > 0 && offset < inode_length (inode);
+           run--, sector_cnt--, offset += BLOCK_SECTOR_SIZE)
+        cache_read_ahead_request (sector_idx++, inode_data_type (inode));
+    }
+  lock_release (&inode->lock);
+}
+
+/* Stores in *SECTOR_CNT the number of data sectors of INODE,
+   counting reserved sectors but not holes, and in *RUN_CNT the
+   number of runs of consecutive sectors they form on disk. */
+void
+inode_count_runs (struct inode *inode, size_t *sector_cnt, size_t *run_cnt)
+{
+  size_t total = bytes_to_sectors (inode_length (inode));
+  block_sector_t next = 0;
+  size_t i;
+
+  *sector_cnt = *run_cnt = 0;
+  lock_acquire (&inode->lock);
+  for (i = 0; i < total; )
+    {
+      size_t run = 1;
+      block_sector_t sector;
+
+      if (inode->data.layout == INODE_BLOCKS)
+        sector = block_entry (inode, i) & ~SECTOR_UNWRITTEN;
+      else
+        sector = byte_to_run (inode, i * BLOCK_SECTOR_SIZE, &run);
+      if (run > total - i)
+        run = total - i;
+      if (sector != 0)
+        {
+          if (sector != next)
+            ++*run_cnt;
+          *sector_cnt += run;
+          next = sector + run;
+        }
+      i += run;
+    }
+  lock_release (&inode->lock);
+}
+
+/* Reserves the sectors that hold bytes OFFSET through OFFSET +
+   LEN - 1 of INODE, extending INODE to OFFSET + LEN bytes if it
+   is shorter.  With the INODE_BLOCKS layout, holes are filled
+   with runs of sectors that are not written but read as zeros
+   until they are, so the reservation costs no data I/O.  With
+   INODE_EXTENTS, the file simply grows.  Returns false if
+   writes to INODE are denied or the disk runs out, in which
+   case some of the range may be reserved. */
+bool
+inode_allocate (struct inode *inode, off_t offset, off_t len)
+{
+  enum cache_type type = inode_data_type (inode);
+  off_t end = offset + len;
+  bool success = true;
+
+  if (offset < 0 || len <= 0 || end < offset)
+    return false;
+  lock_acquire (&inode->lock);
+  if (inode->deny_write_cnt > 0)
+    success = false;
+  else if (inode->data.layout == INODE_INLINE && end > (off_t) INLINE_SIZE)
+    success = inline_migrate (inode);
+
+  if (success && inode->data.layout == INODE_EXTENTS)
+    {
+      success = extent_grow (&inode->data, bytes_to_sectors (end), type);
+      inode->map_changed = true;
+    }
+  else if (success && inode->data.layout == INODE_BLOCKS)
+    {
+      size_t idx = offset / BLOCK_SECTOR_SIZE;
+      size_t last = bytes_to_sectors (end);
+
+      if (last > MAX_BLOCK_SECTORS)
+        success = false;
+      while (success && idx < last)
+        {
+          size_t cnt = 1;
+          if (block_entry (inode, idx) == 0)
+            cnt = blocks_fill (inode, idx, last - idx, type, true);
+          success = cnt > 0;
+          idx += cnt;
+        }
+    }
+
+  if (success && end > inode->data.length)
+    inode->data.length = end;
+  cache_write (inode->sector, CACHE_META, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  lock_release (&inode->lock);
+  return success;
+}
+
+/* Writes the dirty cached sectors of INODE back to disk: its
+   data, its index blocks and, unless DATA_ONLY, its inode
+   sector.  Even with DATA_ONLY the inode sector is written if
+   the length or the block map changed since the last sync,
+   since the data cannot be found without it: filling a hole or
+   writing a reserved sector changes the map but not the length.
+   Falls back to writing back the whole cache if memory is
+   short. */
+void
+inode_sync (struct inode *inode, bool data_only)
+{
+  size_t sector_cnt;
+  size_t double_cnt = 0;
+  block_sector_t *sectors;
+  size_t cnt = 0;
+  size_t i;
+
+  lock_acquire (&inode->lock);
+  if (inode->data.layout == INODE_INLINE)
+    {
+      /* The data is in the inode sector. */
+      cache_flush_sectors (&inode->sector, 1);
+      inode->synced_length = inode->data.length;
+      inode->map_changed = false;
+      lock_release (&inode->lock);
+      return;
+    }
+  sector_cnt = bytes_to_sectors (inode->data.length);
+  if (inode->data.layout == INODE_BLOCKS
+      && sector_cnt > DIRECT_BLOCK + INDIRECT_BLOCK)
+    double_cnt = DIV_ROUND_UP (sector_cnt - DIRECT_BLOCK - INDIRECT_BLOCK,
+                               INDIRECT_BLOCK);
+  sectors = malloc ((sector_cnt + double_cnt + 3) * sizeof *sectors);
+  if (sectors == NULL)
+    {
+      cache_write_back ();
+      inode->synced_length = inode->data.length;
+      inode->map_changed = false;
+      lock_release (&inode->lock);
+      return;
+    }
+
+  /* Data sectors, then the index blocks leading to them,
+     skipping holes. */
+  for (i = 0; i < sector_cnt; )
+    {
+      size_t run;
+      block_sector_t sector = byte_to_run (inode, i * BLOCK_SECTOR_SIZE,
+                                           &run);
+      if (sector == 0)
+        {
+          i++;
+          continue;
+        }
+      for (; run > 0 && i < sector_cnt; run--, i++)
+        sectors[cnt++] = sector++;
+    }
+  if (inode->data.layout == INODE_EXTENTS)
+    {
+      if (inode->data.extent_block != 0)
+        sectors[cnt++] = inode->data.extent_block;
+    }
+  else if (inode->data.indirect_part != 0)
+    sectors[cnt++] = inode->data.indirect_part;
+  if (double_cnt > 0 && inode->data.double_indirect_part != 0)
+    {
+      struct inode_indirect inode_indirect;
+      sectors[cnt++] = inode->data.double_indirect_part;
+      cache_read_sector (inode->data.double_indirect_part, CACHE_META,
+                         &inode_indirect, 0, BLOCK_SECTOR_SIZE);
+      for (i = 0; i < double_cnt; i++)
+        if (inode_indirect.indirect_inode[i] != 0)
+          sectors[cnt++] = inode_indirect.indirect_inode[i];
+    }
+  if (!data_only || inode->synced_length != inode->data.length
+      || inode->map_changed)
+    sectors[cnt++] = inode->sector;
+
+  cache_flush_sectors (sectors, cnt);
+  inode->synced_length = inode->data.length;
+  inode->map_changed = false;
+  lock_release (&inode->lock);
+  free (sectors);
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   A write past end of file extends the inode. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
                 off_t offset) 
+{
+  off_t bytes_written;
+
+  lock_acquire (&inode->lock);
+  bytes_written = write_at_locked (inode, buffer, size, offset);
+  lock_release (&inode->lock);
+  return bytes_written;
+}
+
+/* Moves the inline data of INODE, which is locked, out to
+   sectors of the layout of new inodes, so that INODE can grow
+   past INLINE_SIZE bytes.  The data fits in one sector, which
+   is allocated and written before the inode changes, so that
+   on failure the inode keeps its data untouched.  Returns false
+   if memory or the disk runs out. */
+static bool
+inline_migrate (struct inode *inode)
+{
+  struct inode_disk *data = &inode->data;
+  block_sector_t sector = 0;
+
+  if (data->length > 0)
+    {
+      uint8_t *block = calloc (1, BLOCK_SECTOR_SIZE);
+      if (block == NULL)
+        return false;
+      if (!free_map_allocate_near (inode->sector + 1, 1, &sector))
+        {
+          free (block);
+          return false;
+        }
+      memcpy (block, data->inline_data, INLINE_SIZE);
+      cache_write (sector, inode_data_type (inode), block, 0,
+                   BLOCK_SECTOR_SIZE);
+      free (block);
+    }
+
+  memset (data->inline_data, 0, INLINE_SIZE);
+  data->layout = new_layout;
+  if (sector != 0 && new_layout == INODE_EXTENTS)
+    {
+      data->extents[0].start = sector;
+      data->extents[0].length = 1;
+      data->extent_cnt = 1;
+    }
+  else if (sector != 0)
+    data->direct_part[0] = sector;
+  inode->map_changed = true;
+  cache_write (inode->sector, CACHE_META, data, 0, BLOCK_SECTOR_SIZE);
+  return true;
+}
+
+/* Does the work of inode_write_at(), with INODE locked. */
+static off_t
+write_at_locked (struct inode *inode, const void *buffer_, off_t size,
+                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
   uint8_t *bounce = NULL;
-  
+  enum cache_type type = inode_data_type (inode);
+
 
   if (inode->deny_write_cnt)
     return 0;
 
+  if (inode->data.layout == INODE_INLINE)
+    {
+      if (offset + size <= (off_t) INLINE_SIZE)
+        {
+          memcpy (inode->data.inline_data + offset, buffer, size);
+          if (offset + size > inode->data.length)
+            inode->data.length = offset + size;
+          cache_write (inode->sector, CACHE_META, &inode->data, 0,
+                       BLOCK_SECTOR_SIZE);
+          return size;
+        }
+      if (!inline_migrate (inode))
+        return 0;
+    }
 
   if ((int)byte_to_sector (inode, offset + size - 1) == -1){
-    static char zeros[BLOCK_SECTOR_SIZE];
     size_t sectors = bytes_to_sectors(offset + size);
-    /* If direct, finish immdiately after writing sectors. */
-    for (int i = 0; i < DIRECT_BLOCK; i++){
-      if (i == sectors){
-        /* write direct part and start then */
+    /* With extents, take the new sectors in as few runs as
+       possible.  Keep what was got even on failure, so that it
+       is released with the inode. */
+    if (inode->data.layout == INODE_EXTENTS){
+      bool grown = extent_grow (&inode->data, sectors, type);
+      inode->map_changed = true;
+      if (grown)
         inode->data.length = offset + size;
-        cache_write(inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
-        goto start;
-        break;
-      }
-      if (inode->data.direct_part[i] == 0){
-        /* if the sectors is not allocated, fill it with zeros. */
-        free_map_allocate(1, &inode->data.direct_part[i]);
-        cache_write(inode->data.direct_part[i], zeros, 0, BLOCK_SECTOR_SIZE);
-      }
-    }
-    /* If in indirect part of inode: */
-    if (sectors - DIRECT_BLOCK < INDIRECT_BLOCK){
-      /* Load indirect part and write indirect part and start then */
-      write_indirect(&inode->data.indirect_part, sectors - DIRECT_BLOCK);
-      inode->data.length = offset + size;
-      cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
-      goto start;
-    }
-    /* If in double indirect part of inode: */
-    if (sectors - DIRECT_BLOCK - INDIRECT_BLOCK < DOUBLE_INDIRECT){
-      /* Load double indirect part and write and start then */
-      int length = sectors - DIRECT_BLOCK - INDIRECT_BLOCK;
-      write_double(&inode->data.double_indirect_part, length);
-      inode->data.length = offset + size;
-      cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+      cache_write (inode->sector, CACHE_META, &inode->data, 0,
+                   BLOCK_SECTOR_SIZE);
+      if (!grown)
+        return 0;
       goto start;
     }
+    /* Otherwise the new part of the file is a hole, and only
+       the sectors written below are allocated. */
+    if (sectors > MAX_BLOCK_SECTORS)
+      return 0;
+    inode->data.length = offset + size;
+    cache_write (inode->sector, CACHE_META, &inode->data, 0,
+                 BLOCK_SECTOR_SIZE);
   }
 
   start:
@@ -417,7 +1348,15 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       int chunk_size = size < min_left ? size : min_left;
       if (chunk_size <= 0)
         break;
-      cache_write(sector_idx, bytes_written+buffer, sector_ofs, chunk_size);
+      if (sector_idx == 0)
+        sector_idx = byte_to_sector_alloc (inode, offset,
+                                           DIV_ROUND_UP (sector_ofs + size,
+                                                         BLOCK_SECTOR_SIZE),
+                                           type);
+      if (sector_idx == 0)
+        break;
+      cache_write(sector_idx, type, bytes_written+buffer, sector_ofs,
+                  chunk_size);
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
@@ -433,8 +1372,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -443,9 +1384,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&inode->lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -454,54 +1397,3 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
-
-/* Helper function for write operation for the cache, where we 
-   need to write size sectors into the cache, and the sectors 
-   are all in indirect parts of the inode. */
-void write_indirect(block_sector_t* sectors, int size)
-{
-  static char zeros[BLOCK_SECTOR_SIZE];
-  if (*sectors == 0){
-    /* if the sectors is not allocated, fill it with zeros. */
-    free_map_allocate(1, sectors);
-    cache_write(*sectors, zeros, 0, BLOCK_SECTOR_SIZE);
-  }
-  /* Load indirect part and justify whether it is allocated */
-  struct inode_indirect inode_indirect;
-  cache_read_sector(*sectors, &inode_indirect, 0, BLOCK_SECTOR_SIZE);
-  for (int i = 0; i < size; i++){
-    if (inode_indirect.indirect_inode[i] == 0){
-      /* if the sectors is not allocated, fill it with zeros. */
-      free_map_allocate(1, &inode_indirect.indirect_inode[i]);
-      cache_write(inode_indirect.indirect_inode[i], 
-                  zeros, 0, BLOCK_SECTOR_SIZE);
-     }
-  }
-  /* write the changes into cache. */
-  cache_write (*sectors, &inode_indirect, 0, BLOCK_SECTOR_SIZE);
-}
-
-/* Helper function for write operation for the cache, where we 
-   need to write size sectors into the cache, and the sectors 
-   are all in double indirect parts of the inode. */
-void write_double(block_sector_t* sectors, int size)
-{
-  if (*sectors == 0){
-    /* if the sectors is not allocated, fill it with zeros. */
-    free_map_allocate (1, sectors);
-    static char zeros[BLOCK_SECTOR_SIZE];
-    cache_write (*sectors, zeros, 0, BLOCK_SECTOR_SIZE);
-  }
-  /* Load double indirect part and justify whether it is allocated */
-  struct inode_indirect inode_indirect;
-  cache_read_sector(*sectors, &inode_indirect, 0, BLOCK_SECTOR_SIZE);
-  int offset = size / INDIRECT_BLOCK + 1;
-  /* double indirect part is saperated into offset indirect parts. */
-  for (int i = 0; i < offset; i++){
-    /* for each first level of indirect block, do the same write 
-       operation, and can just call the indirect function.*/
-    write_indirect(&inode_indirect.indirect_inode[i], INDIRECT_BLOCK);
-  }
-  /* write the changes into cache. */
-  cache_write (*sectors, &inode_indirect, 0, BLOCK_SECTOR_SIZE);
-}
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
+#include "filesys/cache.h"
+#include "threads/synch.h"
+#include <hash.h>
 #include <list.h>
 #include <round.h>
 
@@ -12,6 +15,43 @@
 #define DIRECT_BLOCK 120      /* An inode has DIRECT_BLOCK direct entries. */
 #define INDIRECT_BLOCK 128         /* An inode has a INDIRECT_BLOCK entry. */
 #define DOUBLE_INDIRECT 128 * 128 /* An inode has a DOUBLE_INDIRECT entry. */
+#define MAX_BLOCK_SECTORS (DIRECT_BLOCK + INDIRECT_BLOCK + DOUBLE_INDIRECT)
+
+/* Set in a block map entry whose sector is reserved by
+   inode_allocate() but not yet written, so reads as zeros. */
+#define SECTOR_UNWRITTEN 0x80000000u
+
+/* Index blocks in the block map of an open inode: the indirect
+   block, the double indirect block, then the blocks it points
+   to. */
+#define MAP_INDIRECT 0
+#define MAP_DOUBLE 1
+#define MAP_BLOCK_CNT (2 + INDIRECT_BLOCK)
+
+/* Extents of an inode with the INODE_EXTENTS layout: some in
+   the inode itself, the rest in one extent block. */
+#define INLINE_EXTENTS 60
+#define BLOCK_EXTENTS (BLOCK_SECTOR_SIZE / sizeof (struct inode_extent))
+#define MAX_EXTENTS (INLINE_EXTENTS + BLOCK_EXTENTS)
+
+/* Bytes of data an inode with the INODE_INLINE layout holds in
+   place of the block map. */
+#define INLINE_SIZE ((DIRECT_BLOCK + 2) * sizeof (block_sector_t))
+
+/* Ways an inode can map its data to sectors. */
+enum inode_layout
+  {
+    INODE_BLOCKS,       /* Direct, indirect and double indirect blocks. */
+    INODE_EXTENTS,      /* Runs of contiguous sectors. */
+    INODE_INLINE        /* Data in the inode sector itself. */
+  };
+
+/* A run of LENGTH contiguous sectors starting at START. */
+struct inode_extent
+  {
+    block_sector_t start;               /* First sector. */
+    uint32_t length;                    /* Number of sectors. */
+  };
 
 
 struct bitmap;
@@ -20,16 +60,33 @@ struct bitmap;
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
 struct inode_disk
   {
-    block_sector_t direct_part[DIRECT_BLOCK];  /* direct part of an inode. */
-    block_sector_t indirect_part;            /* indirect part of an inode. */
-    block_sector_t double_indirect_part; /*double direct part of an inode. */
+    union
+      {
+        /* INODE_BLOCKS layout. */
+        struct
+          {
+            block_sector_t direct_part[DIRECT_BLOCK];  /* direct part of an inode. */
+            block_sector_t indirect_part;            /* indirect part of an inode. */
+            block_sector_t double_indirect_part; /*double direct part of an inode. */
+          };
+        /* INODE_EXTENTS layout. */
+        struct
+          {
+            struct inode_extent extents[INLINE_EXTENTS]; /* First extents. */
+            block_sector_t extent_block;  /* Sector of the others, or 0. */
+            uint32_t extent_cnt;          /* Number of extents. */
+          };
+        /* INODE_INLINE layout.  Bytes past the length are zero. */
+        uint8_t inline_data[INLINE_SIZE];
+      };
 
     // block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    // uint32_t unused[125];               /* Not used. */
     block_sector_t parent;
     bool dir_or_file;
+    uint8_t layout;                     /* An enum inode_layout. */
+    uint8_t unused[10];                 /* Not used. */
   };
 
 /* the struct of the indirect part stored in one inode. */
@@ -46,18 +103,32 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
+/* In-memory inode.
+   OPEN_CNT and LOADING are protected by the lock of the open inode
+   table, and the members after them by LOCK.  DIR_LOCK keeps the entries of
+   a directory consistent across a lookup and the write that
+   follows it. */
 struct inode 
   {
-    struct list_elem elem;            /* Element in inode list. */
+    struct hash_elem elem;            /* Element in open inode table. */
     block_sector_t sector;            /* Sector number of disk location. */
     int open_cnt;                     /* Number of openers. */
+    bool loading;                     /* Disk inode still being read? */
+    struct lock lock;                 /* Protects the members below. */
+    struct lock dir_lock;             /* Held by directory operations. */
     bool removed;                     /* True if deleted, false otherwise. */
     int deny_write_cnt;               /* 0: writes ok, >0: deny writes. */
+    off_t synced_length;              /* Length at last sync, or -1. */
+    bool map_changed;                 /* Block map changed since sync? */
+    struct inode_indirect *map[MAP_BLOCK_CNT]; /* Copies of index
+                                                  blocks, or null. */
     struct inode_disk data;           /* Inode content. */
   };
 
 void inode_init (void);
+void inode_set_layout (enum inode_layout);
+enum inode_layout inode_get_layout (const struct inode *);
+void inode_print_stats (void);
 bool inode_create (block_sector_t, off_t, 
                   block_sector_t parent, bool dir_or_file);
 struct inode *inode_open (block_sector_t);
@@ -65,14 +136,17 @@ struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+void inode_release (block_sector_t);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+const void *inode_pin_read (struct inode *, off_t offset, off_t *avail,
+                            struct cache_entry **);
+void inode_read_ahead (struct inode *, off_t offset, int sector_cnt);
+void inode_sync (struct inode *, bool data_only);
+bool inode_allocate (struct inode *, off_t offset, off_t len);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
-
-/* Helper functions for write operation for the cache. */
-void write_indirect(block_sector_t* sectors, int size);
-void write_double(block_sector_t* sectors, int size);
+void inode_count_runs (struct inode *, size_t *sector_cnt, size_t *run_cnt);
 
 #endif /* filesys/inode.h */
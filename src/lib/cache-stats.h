@@ -0,0 +1,25 @@
+#ifndef __LIB_CACHE_STATS_H
+#define __LIB_CACHE_STATS_H
+
+/* Counters of the buffer cache and the file system device,
+   as returned by the cache_stats system call.  All count
+   from boot, so a benchmark takes one snapshot before and
+   one after its workload and subtracts. */
+struct cache_stats
+  {
+    long long hit_cnt;            /* Sectors found cached. */
+    long long miss_cnt;           /* Sectors read on demand. */
+    long long evict_cnt;          /* Entries evicted. */
+    long long dirty_evict_cnt;    /* Of those, written back first. */
+    long long flush_cnt;          /* Write back passes with work. */
+    long long flush_sector_cnt;   /* Sectors written by those. */
+    long long clean_cnt;          /* Runs of the cleaner thread. */
+    long long ahead_read_cnt;     /* Sectors read ahead. */
+    long long ahead_hit_cnt;      /* Of those, later used. */
+    long long ahead_waste_cnt;    /* Of those, evicted unused. */
+    long long device_read_cnt;    /* Sectors read from the device. */
+    long long device_write_cnt;   /* Sectors written to the device. */
+    long long device_read_seek;   /* Sectors between successive reads. */
+  };
+
+#endif /* lib/cache-stats.h */
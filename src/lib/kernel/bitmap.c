@@ -69,6 +69,58 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a mask with the CNT bits starting at bit OFS of an
+   element set to 1, where 0 < CNT and OFS + CNT <= ELEM_BITS. */
+static inline elem_type
+range_mask (size_t ofs, size_t cnt)
+{
+  elem_type high = (ofs + cnt < ELEM_BITS
+                    ? ((elem_type) 1 << (ofs + cnt)) - 1
+                    : (elem_type) -1);
+  return high & ~(((elem_type) 1 << ofs) - 1);
+}
+
+/* Returns the number of bits set to 1 in ELEM.  Adds up the
+   bits in pairs, then in nibbles, then in bytes, all across
+   ELEM at once, because the kernel has no libgcc to supply
+   __builtin_popcount(). */
+static inline size_t
+popcount (elem_type elem)
+{
+  elem_type m1 = (elem_type) -1 / 3;            /* 0x5555... */
+  elem_type m2 = (elem_type) -1 / 5;            /* 0x3333... */
+  elem_type m4 = (elem_type) -1 / 17;           /* 0x0f0f... */
+  elem_type h01 = (elem_type) -1 / 255;         /* 0x0101... */
+
+  elem = elem - ((elem >> 1) & m1);
+  elem = (elem & m2) + ((elem >> 2) & m2);
+  elem = (elem + (elem >> 4)) & m4;
+  return (elem * h01) >> (ELEM_BITS - CHAR_BIT);
+}
+
+/* Returns the index of the first bit in B at or after START and
+   before END that is set to VALUE, or END if there is none.
+   Looks at a whole element at a time, finding the bit within it
+   with a bit-scan instruction. */
+static size_t
+find_bit (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  while (start < end)
+    {
+      size_t idx = elem_idx (start);
+      elem_type elem = value ? b->bits[idx] : ~b->bits[idx];
+
+      elem &= ~(bit_mask (start) - 1);
+      if (elem != 0)
+        {
+          size_t bit = idx * ELEM_BITS + __builtin_ctzl (elem);
+          return bit < end ? bit : end;
+        }
+      start = (idx + 1) * ELEM_BITS;
+    }
+  return end;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -213,18 +265,32 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Works a whole element at a time, each element being set
+   atomically. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (cnt > 0)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < cnt ? ELEM_BITS - ofs : cnt;
+      elem_type *elem = &b->bits[elem_idx (start)];
+      elem_type mask = range_mask (ofs, n);
+
+      /* Like bitmap_mark() and bitmap_reset(), but for all the
+         bits in MASK at once. */
+      if (value)
+        asm ("orl %1, %0" : "+m" (*elem) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "+m" (*elem) : "r" (~mask) : "cc");
+      start += n;
+      cnt -= n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,16 +298,23 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  while (cnt > 0)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = ELEM_BITS - ofs < cnt ? ELEM_BITS - ofs : cnt;
+      size_t ones = popcount (b->bits[elem_idx (start)] & range_mask (ofs, n));
+
+      value_cnt += value ? ones : n - ones;
+      start += n;
+      cnt -= n;
+    }
   return value_cnt;
 }
 
@@ -250,16 +323,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return cnt > 0 && find_bit (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -298,13 +366,44 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  return bitmap_scan_range (b, start, b->bit_cnt, cnt, value);
+}
+
+/* Like bitmap_scan(), but only finds a group that lies entirely
+   between START and END, so that the search looks at no bits at
+   or after END. */
+size_t
+bitmap_scan_range (const struct bitmap *b, size_t start, size_t end,
+                   size_t cnt, bool value)
+{
+  ASSERT (b != NULL);
+  ASSERT (start <= end);
+  ASSERT (end <= b->bit_cnt);
+
+  if (cnt <= end - start) 
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t last = end - cnt;
+      size_t i = start;
+
+      if (cnt == 0)
+        return start;
+
+      /* Jump to the next bit set to VALUE, then to the next one
+         that is not, skipping whole elements at a time.  A run
+         long enough ends the search; otherwise the next one
+         can only start after it. */
+      while (i <= last)
+        {
+          size_t run_end;
+
+          i = find_bit (b, i, last + 1, value);
+          if (i > last)
+            break;
+          run_end = find_bit (b, i, i + cnt, !value);
+          if (run_end == i + cnt)
+            return i;
+          i = run_end;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -358,6 +457,26 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the CNT bits of B starting at START to FILE, at the
+   same offsets bitmap_write() would use.  Whole elements are
+   written, so neighboring bits may be written as well.  Return
+   true if successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  off_t ofs, size;
+
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (cnt <= b->bit_cnt - start);
+
+  if (cnt == 0)
+    return true;
+  ofs = elem_idx (start) * sizeof (elem_type);
+  size = byte_cnt (start + cnt) - ofs;
+  return file_write_at (file, (const char *) b->bits + ofs, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
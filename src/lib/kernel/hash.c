@@ -257,6 +257,27 @@ hash_empty (struct hash *h)
   return h->elem_cnt == 0;
 }
 
+/* Returns the number of buckets in H.  If LONGEST is nonnull,
+   stores in *LONGEST the number of elements in its fullest
+   bucket. */
+size_t
+hash_buckets (struct hash *h, size_t *longest) 
+{
+  if (longest != NULL)
+    {
+      size_t i;
+
+      *longest = 0;
+      for (i = 0; i < h->bucket_cnt; i++)
+        {
+          size_t len = list_size (&h->buckets[i]);
+          if (len > *longest)
+            *longest = len;
+        }
+    }
+  return h->bucket_cnt;
+}
+
 /* Fowler-Noll-Vo hash constants, for 32-bit word sizes. */
 #define FNV_32_PRIME 16777619u
 #define FNV_32_BASIS 2166136261u
@@ -94,6 +94,7 @@ struct hash_elem *hash_cur (struct hash_iterator *);
 /* Information. */
 size_t hash_size (struct hash *);
 bool hash_empty (struct hash *);
+size_t hash_buckets (struct hash *, size_t *longest);
 
 /* Sample hash functions. */
 unsigned hash_bytes (const void *, size_t);
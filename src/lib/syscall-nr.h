@@ -28,7 +28,16 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+    SYS_FSYNC,                  /* Writes a file and its inode to disk. */
+    SYS_FDATASYNC,              /* Writes a file's data to disk. */
+    SYS_FALLOCATE,              /* Reserves space for a file. */
+
+    /* Buffer cache. */
+    SYS_CACHE_STATS,            /* Reads the buffer cache counters. */
+
+    /* File layout. */
+    SYS_FILE_RUNS               /* Counts the runs a file takes on disk. */
   };
 
 #endif /* lib/syscall-nr.h */
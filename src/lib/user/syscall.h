@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <cache-stats.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -44,5 +45,14 @@ bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
+bool fsync (int fd);
+bool fdatasync (int fd);
+bool fallocate (int fd, unsigned offset, unsigned length);
+
+/* Buffer cache. */
+void cache_stats (struct cache_stats *);
+
+/* File layout. */
+int file_runs (int fd);
 
 #endif /* lib/user/syscall.h */
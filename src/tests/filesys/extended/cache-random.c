@@ -0,0 +1,54 @@
+/* Reads small pieces of a file large enough to need double
+   indirect blocks at random offsets, checking each one.  This
+   is a benchmark rather than a correctness test: compare the
+   "stats:" line, which counts the cache accesses over the reads,
+   between kernels to see the cost of mapping offsets to
+   sectors. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (200 * 1024)          /* Reaches double indirect. */
+#define CHUNK_SIZE 64                   /* Bytes per read. */
+#define READ_CNT 1000                   /* Number of reads. */
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void)
+{
+  const char *file_name = "large";
+  struct cache_stats before, after;
+  char chunk[CHUNK_SIZE];
+  int fd;
+  int i;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write \"%s\"", file_name);
+
+  msg ("read \"%s\" at %d random offsets", file_name, READ_CNT);
+  cache_stats (&before);
+  for (i = 0; i < READ_CNT; i++)
+    {
+      size_t ofs = random_ulong () % (FILE_SIZE - CHUNK_SIZE);
+      seek (fd, ofs);
+      if (read (fd, chunk, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("read %d bytes at offset %zu in \"%s\"",
+              CHUNK_SIZE, ofs, file_name);
+      compare_bytes (chunk, buf + ofs, CHUNK_SIZE, ofs, file_name);
+    }
+  cache_stats (&after);
+
+  msg ("stats: %lld cache accesses, %lld device reads",
+       (after.hit_cnt + after.miss_cnt) - (before.hit_cnt + before.miss_cnt),
+       after.device_read_cnt - before.device_read_cnt);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_STATS => 1, [<<'EOF']);
+(cache-random) begin
+(cache-random) create "large"
+(cache-random) open "large"
+(cache-random) write "large"
+(cache-random) read "large" at 1000 random offsets
+(cache-random) close "large"
+(cache-random) end
+EOF
+pass;
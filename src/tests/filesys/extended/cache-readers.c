@@ -0,0 +1,33 @@
+/* Spawns 10 child processes that all read the same sector of
+   the same file over and over, so that their reads meet on one
+   buffer cache entry.  This is a benchmark rather than a
+   correctness test: compare the "Timer: # ticks" line at
+   shutdown between kernels to see the effect of letting readers
+   share a cache entry. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/filesys/extended/cache-readers.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[BUF_SIZE];
+
+#define CHILD_CNT 10
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+  int fd;
+
+  CHECK (create (file_name, sizeof buf), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  random_bytes (buf, sizeof buf);
+  CHECK (write (fd, buf, sizeof buf) > 0, "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  exec_children ("child-cache-rd", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
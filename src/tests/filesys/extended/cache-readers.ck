@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-readers) begin
+(cache-readers) create "hot"
+(cache-readers) open "hot"
+(cache-readers) write "hot"
+(cache-readers) close "hot"
+(cache-readers) exec child 1 of 10: "child-cache-rd 0"
+(cache-readers) exec child 2 of 10: "child-cache-rd 1"
+(cache-readers) exec child 3 of 10: "child-cache-rd 2"
+(cache-readers) exec child 4 of 10: "child-cache-rd 3"
+(cache-readers) exec child 5 of 10: "child-cache-rd 4"
+(cache-readers) exec child 6 of 10: "child-cache-rd 5"
+(cache-readers) exec child 7 of 10: "child-cache-rd 6"
+(cache-readers) exec child 8 of 10: "child-cache-rd 7"
+(cache-readers) exec child 9 of 10: "child-cache-rd 8"
+(cache-readers) exec child 10 of 10: "child-cache-rd 9"
+(cache-readers) wait for child 1 of 10 returned 0 (expected 0)
+(cache-readers) wait for child 2 of 10 returned 1 (expected 1)
+(cache-readers) wait for child 3 of 10 returned 2 (expected 2)
+(cache-readers) wait for child 4 of 10 returned 3 (expected 3)
+(cache-readers) wait for child 5 of 10 returned 4 (expected 4)
+(cache-readers) wait for child 6 of 10 returned 5 (expected 5)
+(cache-readers) wait for child 7 of 10 returned 6 (expected 6)
+(cache-readers) wait for child 8 of 10 returned 7 (expected 7)
+(cache-readers) wait for child 9 of 10 returned 8 (expected 8)
+(cache-readers) wait for child 10 of 10 returned 9 (expected 9)
+(cache-readers) end
+EOF
+pass;
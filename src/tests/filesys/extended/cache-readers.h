@@ -0,0 +1,8 @@
+#ifndef TESTS_FILESYS_EXTENDED_CACHE_READERS_H
+#define TESTS_FILESYS_EXTENDED_CACHE_READERS_H
+
+#define BUF_SIZE 512
+#define READ_CNT 256
+static const char file_name[] = "hot";
+
+#endif /* tests/filesys/extended/cache-readers.h */
@@ -0,0 +1,4 @@
+/* Mixes a streaming reader with repeated reads of small files
+   under the default 2Q replacement policy. */
+
+#include "tests/filesys/extended/cache-scan.inc"
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_STATS => 1, [<<'EOF']);
+(cache-scan-2q) begin
+(cache-scan-2q) mkdir "meta"
+(cache-scan-2q) create "stream"
+(cache-scan-2q) open "stream"
+(cache-scan-2q) close "stream"
+(cache-scan-2q) stream "stream" 4 times
+(cache-scan-2q) end
+EOF
+pass;
@@ -0,0 +1,5 @@
+/* Mixes a streaming reader with repeated reads of small files
+   under the clock replacement policy, for comparison with
+   cache-scan-2q. */
+
+#include "tests/filesys/extended/cache-scan.inc"
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_STATS => 1, [<<'EOF']);
+(cache-scan-clock) begin
+(cache-scan-clock) mkdir "meta"
+(cache-scan-clock) create "stream"
+(cache-scan-clock) open "stream"
+(cache-scan-clock) close "stream"
+(cache-scan-clock) stream "stream" 4 times
+(cache-scan-clock) end
+EOF
+pass;
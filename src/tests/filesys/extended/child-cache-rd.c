@@ -0,0 +1,42 @@
+/* Child process for cache-readers test.
+   Reads the one sector of the test file READ_CNT times and
+   makes sure each read returns what the parent wrote. */
+
+#include <random.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/filesys/extended/cache-readers.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-cache-rd";
+
+static char expected[BUF_SIZE];
+static char buf[BUF_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  int child_idx;
+  int fd;
+  int i;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  random_init (0);
+  random_bytes (expected, sizeof expected);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (i = 0; i < READ_CNT; i++) 
+    {
+      seek (fd, 0);
+      CHECK (read (fd, buf, sizeof buf) == (int) sizeof buf,
+             "read \"%s\"", file_name);
+      compare_bytes (buf, expected, sizeof buf, 0, file_name);
+    }
+  close (fd);
+
+  return child_idx;
+}
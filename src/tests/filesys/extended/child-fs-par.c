@@ -0,0 +1,49 @@
+/* Child process for fs-parallel test.
+   Writes a file named after its index, reads it back PASS_CNT
+   times checking each read, then removes it. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/filesys/extended/fs-parallel.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-fs-par";
+
+static char expected[FILE_SIZE];
+static char buf[FILE_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char file_name[16];
+  int child_idx;
+  int fd;
+  int i;
+
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  snprintf (file_name, sizeof file_name, "par%d", child_idx);
+
+  random_init (child_idx);
+  random_bytes (expected, sizeof expected);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, expected, sizeof expected) == (int) sizeof expected,
+         "write \"%s\"", file_name);
+  for (i = 0; i < PASS_CNT; i++) 
+    {
+      seek (fd, 0);
+      CHECK (read (fd, buf, sizeof buf) == (int) sizeof buf,
+             "read \"%s\"", file_name);
+      compare_bytes (buf, expected, sizeof buf, 0, file_name);
+    }
+  close (fd);
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+
+  return child_idx;
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(extent-seq-lg) begin
+(extent-seq-lg) create "testme"
+(extent-seq-lg) open "testme"
+(extent-seq-lg) writing "testme"
+(extent-seq-lg) close "testme"
+(extent-seq-lg) open "testme" for verification
+(extent-seq-lg) verified contents of "testme"
+(extent-seq-lg) close "testme"
+(extent-seq-lg) end
+EOF
+pass;
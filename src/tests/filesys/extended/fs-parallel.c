@@ -0,0 +1,21 @@
+/* Spawns 4 child processes that each write, read back and remove
+   a file of their own, so that none of their file system calls
+   need to wait for another's.  This is a benchmark rather than a
+   correctness test: compare the "Timer: # ticks" line at
+   shutdown between kernels to see how well independent file
+   operations overlap. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void) 
+{
+  pid_t children[CHILD_CNT];
+
+  exec_children ("child-fs-par", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fs-parallel) begin
+(fs-parallel) exec child 1 of 4: "child-fs-par 0"
+(fs-parallel) exec child 2 of 4: "child-fs-par 1"
+(fs-parallel) exec child 3 of 4: "child-fs-par 2"
+(fs-parallel) exec child 4 of 4: "child-fs-par 3"
+(fs-parallel) wait for child 1 of 4 returned 0 (expected 0)
+(fs-parallel) wait for child 2 of 4 returned 1 (expected 1)
+(fs-parallel) wait for child 3 of 4 returned 2 (expected 2)
+(fs-parallel) wait for child 4 of 4 returned 3 (expected 3)
+(fs-parallel) end
+EOF
+pass;
@@ -0,0 +1,7 @@
+#ifndef TESTS_FILESYS_EXTENDED_FS_PARALLEL_H
+#define TESTS_FILESYS_EXTENDED_FS_PARALLEL_H
+
+#define FILE_SIZE (48 * 1024)
+#define PASS_CNT 4
+
+#endif /* tests/filesys/extended/fs-parallel.h */
@@ -0,0 +1,4 @@
+/* Reads back files written to several directories at once,
+   with inodes placed by block group. */
+
+#include "tests/filesys/extended/fs-seek.inc"
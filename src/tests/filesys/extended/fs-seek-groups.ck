@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_STATS => 1, [<<'EOF']);
+(fs-seek-groups) begin
+(fs-seek-groups) mkdir "dir0"
+(fs-seek-groups) mkdir "dir1"
+(fs-seek-groups) mkdir "dir2"
+(fs-seek-groups) mkdir "dir3"
+(fs-seek-groups) create 12 files in each directory
+(fs-seek-groups) read the files of each directory
+(fs-seek-groups) end
+EOF
+pass;
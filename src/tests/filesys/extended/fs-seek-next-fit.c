@@ -0,0 +1,5 @@
+/* Reads back files written to several directories at once,
+   with inodes placed next-fit, for comparison with
+   fs-seek-groups. */
+
+#include "tests/filesys/extended/fs-seek.inc"
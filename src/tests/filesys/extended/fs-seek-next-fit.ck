@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_STATS => 1, [<<'EOF']);
+(fs-seek-next-fit) begin
+(fs-seek-next-fit) mkdir "dir0"
+(fs-seek-next-fit) mkdir "dir1"
+(fs-seek-next-fit) mkdir "dir2"
+(fs-seek-next-fit) mkdir "dir3"
+(fs-seek-next-fit) create 12 files in each directory
+(fs-seek-next-fit) read the files of each directory
+(fs-seek-next-fit) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_archive ({"reserved" => ["\0" x 7000, random_bytes (3000),
+                               "\0" x 10000]});
+pass;
@@ -0,0 +1,74 @@
+/* Reserves space for a file with fallocate, checks that the
+   reserved range reads as zeros, then writes into the middle of
+   it and checks the contents.  Checks with the cache statistics
+   that fallocate writes no sectors and that reading the reserved
+   range reads none, and that the reservation is one run of
+   consecutive sectors.  Also checks that fallocate rejects a
+   file descriptor that is not open. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 20000
+#define DATA_OFS 7000
+#define DATA_SIZE 3000
+
+static char buf[FILE_SIZE];
+static char zeros[FILE_SIZE];
+
+void
+test_main (void)
+{
+  const char *file_name = "reserved";
+  struct cache_stats before, after;
+  long long written, read_cnt;
+  int runs;
+  int fd;
+
+  random_init (0);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  cache_stats (&before);
+  CHECK (fallocate (fd, 0, FILE_SIZE), "fallocate %d bytes of \"%s\"",
+         FILE_SIZE, file_name);
+  cache_stats (&after);
+
+  /* Leave out the cache's own write back and eviction, which
+     may write sectors of earlier calls meanwhile. */
+  written = ((after.device_write_cnt - before.device_write_cnt)
+             - (after.flush_sector_cnt - before.flush_sector_cnt)
+             - (after.dirty_evict_cnt - before.dirty_evict_cnt));
+  if (written != 0)
+    fail ("fallocate wrote %lld sectors", written);
+  msg ("fallocate wrote no sectors");
+  if ((runs = file_runs (fd)) != 1)
+    fail ("reserved sectors of \"%s\" are in %d runs", file_name, runs);
+  msg ("reserved sectors of \"%s\" are consecutive", file_name);
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"%s\"", file_name);
+
+  cache_stats (&before);
+  CHECK (read (fd, buf, FILE_SIZE) == FILE_SIZE, "read \"%s\"", file_name);
+  cache_stats (&after);
+  compare_bytes (buf, zeros, FILE_SIZE, 0, file_name);
+  read_cnt = after.device_read_cnt - before.device_read_cnt;
+  if (read_cnt != 0)
+    fail ("reading reserved sectors read %lld from disk", read_cnt);
+  msg ("reading reserved sectors read none from disk");
+
+  memset (buf, 0, sizeof buf);
+  random_bytes (buf + DATA_OFS, DATA_SIZE);
+  seek (fd, DATA_OFS);
+  CHECK (write (fd, buf + DATA_OFS, DATA_SIZE) == DATA_SIZE,
+         "write %d bytes at offset %d in \"%s\"", DATA_SIZE, DATA_OFS,
+         file_name);
+  CHECK (!fallocate (fd + 100, 0, FILE_SIZE),
+         "fallocate of a closed fd must fail");
+  CHECK (file_runs (fd + 100) == -1, "file_runs of a closed fd must fail");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, FILE_SIZE);
+}
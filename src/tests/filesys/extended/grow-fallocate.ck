@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-fallocate) begin
+(grow-fallocate) create "reserved"
+(grow-fallocate) open "reserved"
+(grow-fallocate) fallocate 20000 bytes of "reserved"
+(grow-fallocate) fallocate wrote no sectors
+(grow-fallocate) reserved sectors of "reserved" are consecutive
+(grow-fallocate) filesize "reserved"
+(grow-fallocate) read "reserved"
+(grow-fallocate) reading reserved sectors read none from disk
+(grow-fallocate) write 3000 bytes at offset 7000 in "reserved"
+(grow-fallocate) fallocate of a closed fd must fail
+(grow-fallocate) file_runs of a closed fd must fail
+(grow-fallocate) close "reserved"
+(grow-fallocate) open "reserved" for verification
+(grow-fallocate) verified contents of "reserved"
+(grow-fallocate) close "reserved"
+(grow-fallocate) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Grows a file through sizes that fit in its inode and then past
+   them, checking its contents at each step. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SMALL_SIZE 400                  /* Fits in the inode. */
+#define LARGE_SIZE 1500                 /* Does not. */
+#define CHUNK_SIZE 100
+
+static char buf[LARGE_SIZE];
+
+static void
+write_to (int fd, const char *file_name, size_t size)
+{
+  size_t ofs;
+
+  for (ofs = filesize (fd); ofs < size; ofs += CHUNK_SIZE)
+    if (write (fd, buf + ofs, CHUNK_SIZE) != CHUNK_SIZE)
+      fail ("write %d bytes at offset %zu in \"%s\"",
+            CHUNK_SIZE, ofs, file_name);
+}
+
+void
+test_main (void)
+{
+  const char *file_name = "inline";
+  int fd;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  msg ("write \"%s\" up to %d bytes", file_name, SMALL_SIZE);
+  write_to (fd, file_name, SMALL_SIZE);
+  check_file (file_name, buf, SMALL_SIZE);
+  msg ("write \"%s\" up to %d bytes", file_name, LARGE_SIZE);
+  write_to (fd, file_name, LARGE_SIZE);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, LARGE_SIZE);
+}
@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"sparse" => ["\0" x 200000, "written into a hole\0",
+                             "\0" x (300000 - 200000 - 20)]});
+pass;
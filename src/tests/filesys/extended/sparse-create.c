@@ -0,0 +1,54 @@
+/* Creates a file with a large initial size, which should touch
+   only a few sectors since the file starts out as a hole, then
+   checks that it reads as zeros and that a write in the middle
+   of the hole lands where it should. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE 300000
+#define DATA_OFS 200000
+#define CHUNK_SIZE 512
+
+static char buf[FILE_SIZE];
+static const char data[] = "written into a hole";
+
+void
+test_main (void)
+{
+  const char *file_name = "sparse";
+  struct cache_stats before, after;
+  long long accesses;
+  char zeros[CHUNK_SIZE];
+  int fd;
+
+  cache_stats (&before);
+  CHECK (create (file_name, FILE_SIZE), "create \"%s\"", file_name);
+  cache_stats (&after);
+  accesses = ((after.hit_cnt + after.miss_cnt)
+              - (before.hit_cnt + before.miss_cnt));
+  if (accesses >= 64)
+    fail ("creating \"%s\" took %lld cache accesses", file_name, accesses);
+  msg ("creating \"%s\" took few cache accesses", file_name);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"%s\"", file_name);
+  msg ("read the middle of \"%s\"", file_name);
+  memset (zeros, 0, sizeof zeros);
+  seek (fd, FILE_SIZE / 2);
+  if (read (fd, buf, sizeof zeros) != sizeof zeros)
+    fail ("read %zu bytes from \"%s\"", sizeof zeros, file_name);
+  compare_bytes (buf, zeros, sizeof zeros, FILE_SIZE / 2, file_name);
+
+  seek (fd, DATA_OFS);
+  CHECK (write (fd, data, sizeof data) == sizeof data,
+         "write \"%s\" at offset %d", file_name, DATA_OFS);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  memset (buf, 0, sizeof buf);
+  memcpy (buf + DATA_OFS, data, sizeof data);
+  check_file (file_name, buf, sizeof buf);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-create) begin
+(sparse-create) create "sparse"
+(sparse-create) creating "sparse" took few cache accesses
+(sparse-create) open "sparse"
+(sparse-create) filesize "sparse"
+(sparse-create) read the middle of "sparse"
+(sparse-create) write "sparse" at offset 200000
+(sparse-create) close "sparse"
+(sparse-create) open "sparse" for verification
+(sparse-create) verified contents of "sparse"
+(sparse-create) close "sparse"
+(sparse-create) end
+EOF
+pass;
@@ -0,0 +1,180 @@
+/* Writes a file, making it durable with fsync, then grows it
+   and makes the new data durable with fdatasync.  Checks with
+   the cache statistics that fsync writes exactly the dirty
+   sectors of the file, that fdatasync writes no more than
+   those, and that syncing again writes nothing.  Then checks
+   that fdatasync writes the inode after a write into a range
+   reserved with fallocate, or into a hole of a sparse file,
+   either of which changes the block map in the inode but not
+   the length.  Also checks that both calls reject
+   a file descriptor that is not open. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[70000];
+
+#define SECTOR_SIZE 512
+#define FIRST_SIZE 5678
+
+/* Sectors dirtied by writing FIRST_SIZE bytes: the data and
+   the inode. */
+#define FIRST_DIRTY ((FIRST_SIZE + SECTOR_SIZE - 1) / SECTOR_SIZE + 1)
+
+/* Most sectors dirtied by writing the rest of BUF: the data
+   from the sector FIRST_SIZE ends in, one indirect block and
+   the inode. */
+#define REST_DIRTY ((sizeof buf + SECTOR_SIZE - 1) / SECTOR_SIZE \
+                    - FIRST_SIZE / SECTOR_SIZE + 2)
+
+/* Size of the file whose block map changes. */
+#define MAP_SIZE (8 * SECTOR_SIZE)
+
+/* Number of times a write and sync are tried before giving up
+   on catching them without a write back between. */
+#define TRY_CNT 3
+
+/* Syncs FD, with fdatasync if DATA_ONLY, else fsync, and
+   returns the number of sectors the call wrote itself: the
+   device writes over the call less those of the cache's own
+   write back and of eviction.  If CLEANED is nonnull, adds to
+   it the number of write back passes meanwhile. */
+static long long
+sync_writes (int fd, bool data_only, long long *cleaned)
+{
+  struct cache_stats before, after;
+
+  cache_stats (&before);
+  if (!(data_only ? fdatasync (fd) : fsync (fd)))
+    fail ("%s failed", data_only ? "fdatasync" : "fsync");
+  cache_stats (&after);
+  if (cleaned != NULL)
+    *cleaned += after.flush_cnt - before.flush_cnt;
+  return ((after.device_write_cnt - before.device_write_cnt)
+          - (after.flush_sector_cnt - before.flush_sector_cnt)
+          - (after.dirty_evict_cnt - before.dirty_evict_cnt));
+}
+
+/* Creates FILE_NAME, MAP_SIZE bytes long, reserving them with
+   fallocate if RESERVE or else leaving them a hole, and fsyncs
+   it.  Then writes one sector into that range and checks that
+   fdatasync writes both that sector and the inode, which maps
+   it.  Removes the file. */
+static void
+check_map_sync (const char *file_name, bool reserve)
+{
+  long long written = 0;
+  long long cleaned;
+  int try;
+  int fd;
+
+  CHECK (create (file_name, reserve ? 0 : MAP_SIZE), "create \"%s\"",
+         file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  if (reserve)
+    CHECK (fallocate (fd, 0, MAP_SIZE), "fallocate %d bytes of \"%s\"",
+           MAP_SIZE, file_name);
+  CHECK (fsync (fd), "fsync \"%s\"", file_name);
+
+  /* Each try writes a sector not written yet, so that the write
+     changes the block map again. */
+  msg ("write a sector of \"%s\" and fdatasync", file_name);
+  for (try = 0; try < TRY_CNT; try++)
+    {
+      struct cache_stats before, after;
+
+      seek (fd, try * SECTOR_SIZE);
+      cache_stats (&before);
+      if (write (fd, buf, SECTOR_SIZE) != SECTOR_SIZE)
+        fail ("write %d bytes to \"%s\"", SECTOR_SIZE, file_name);
+      cache_stats (&after);
+      cleaned = after.flush_cnt - before.flush_cnt;
+      written = sync_writes (fd, true, &cleaned);
+      if (cleaned == 0)
+        break;
+    }
+  if (try == TRY_CNT)
+    fail ("write back ran during each of %d tries", TRY_CNT);
+  if (written != 2)
+    fail ("fdatasync wrote %lld sectors, not the data and the inode",
+          written);
+  msg ("fdatasync wrote the data and the inode");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  CHECK (remove (file_name), "remove \"%s\"", file_name);
+}
+
+void
+test_main (void)
+{
+  const char *file_name = "synced";
+  struct cache_stats before, after;
+  long long written = 0;
+  long long cleaned;
+  int try;
+  int fd = -1;
+
+  random_init (0);
+  random_bytes (buf, sizeof buf);
+
+  /* A write back between the write and fsync would leave fewer
+     sectors for fsync, so if one happens start over with a new
+     file, which dirties the same sectors again. */
+  msg ("create \"%s\", write %d bytes and fsync", file_name, FIRST_SIZE);
+  for (try = 0; try < TRY_CNT; try++)
+    {
+      if (try > 0)
+        {
+          close (fd);
+          if (!remove (file_name))
+            fail ("remove \"%s\"", file_name);
+        }
+      if (!create (file_name, 0))
+        fail ("create \"%s\"", file_name);
+      if ((fd = open (file_name)) < 2)
+        fail ("open \"%s\"", file_name);
+      cache_stats (&before);
+      if (write (fd, buf, FIRST_SIZE) != FIRST_SIZE)
+        fail ("write %d bytes to \"%s\"", FIRST_SIZE, file_name);
+      cache_stats (&after);
+      cleaned = after.flush_cnt - before.flush_cnt;
+      written = sync_writes (fd, false, &cleaned);
+      if (cleaned == 0)
+        break;
+    }
+  if (try == TRY_CNT)
+    fail ("write back ran during each of %d tries", TRY_CNT);
+  if (written != FIRST_DIRTY)
+    fail ("fsync wrote %lld sectors, but %d were dirty",
+          written, FIRST_DIRTY);
+  msg ("fsync wrote the %d dirty sectors", FIRST_DIRTY);
+  if ((written = sync_writes (fd, false, NULL)) != 0)
+    fail ("fsync again wrote %lld sectors", written);
+  msg ("fsync again wrote nothing");
+
+  /* This write overflows the cache, so some of its sectors are
+     written back before fdatasync can get to them. */
+  CHECK (write (fd, buf + FIRST_SIZE, sizeof buf - FIRST_SIZE)
+         == (int) (sizeof buf - FIRST_SIZE),
+         "write %zu more bytes to \"%s\"", sizeof buf - FIRST_SIZE,
+         file_name);
+  written = sync_writes (fd, true, NULL);
+  if (written > (long long) REST_DIRTY)
+    fail ("fdatasync wrote %lld sectors, but at most %zu were dirty",
+          written, REST_DIRTY);
+  msg ("fdatasync wrote at most the dirty sectors");
+  if ((written = sync_writes (fd, true, NULL)) != 0)
+    fail ("fdatasync again wrote %lld sectors", written);
+  msg ("fdatasync again wrote nothing");
+
+  check_map_sync ("reserved", true);
+  check_map_sync ("sparse", false);
+
+  CHECK (!fsync (fd + 100), "fsync of a closed fd must fail");
+  CHECK (!fdatasync (fd + 100), "fdatasync of a closed fd must fail");
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
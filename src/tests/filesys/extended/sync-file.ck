@@ -0,0 +1,36 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sync-file) begin
+(sync-file) create "synced", write 5678 bytes and fsync
+(sync-file) fsync wrote the 13 dirty sectors
+(sync-file) fsync again wrote nothing
+(sync-file) write 64322 more bytes to "synced"
+(sync-file) fdatasync wrote at most the dirty sectors
+(sync-file) fdatasync again wrote nothing
+(sync-file) create "reserved"
+(sync-file) open "reserved"
+(sync-file) fallocate 4096 bytes of "reserved"
+(sync-file) fsync "reserved"
+(sync-file) write a sector of "reserved" and fdatasync
+(sync-file) fdatasync wrote the data and the inode
+(sync-file) close "reserved"
+(sync-file) remove "reserved"
+(sync-file) create "sparse"
+(sync-file) open "sparse"
+(sync-file) fsync "sparse"
+(sync-file) write a sector of "sparse" and fdatasync
+(sync-file) fdatasync wrote the data and the inode
+(sync-file) close "sparse"
+(sync-file) remove "sparse"
+(sync-file) fsync of a closed fd must fail
+(sync-file) fdatasync of a closed fd must fail
+(sync-file) close "synced"
+(sync-file) open "synced" for verification
+(sync-file) verified contents of "synced"
+(sync-file) close "synced"
+(sync-file) end
+EOF
+pass;
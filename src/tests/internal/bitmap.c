@@ -0,0 +1,186 @@
+/* Test program for the bit scanning in lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_count(), bitmap_contains() and
+   bitmap_set_multiple(), which work a whole element at a time,
+   against simple loops over single bits, then times both on a
+   large, mostly full bitmap such as the free map of a nearly
+   full disk.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Maximum number of bits in a bitmap checked for correctness. */
+#define MAX_SIZE 300
+
+/* Number of bits in the bitmap used for timing: one bit per
+   sector of a 64 MB disk. */
+#define BENCH_SIZE (64 * 2048)
+
+/* Number of times each timed operation is repeated. */
+#define BENCH_REPEAT 20
+
+static size_t loop_scan (const struct bitmap *, size_t start, size_t cnt,
+                         bool);
+static size_t loop_count (const struct bitmap *, size_t start, size_t cnt,
+                          bool);
+static bool loop_contains (const struct bitmap *, size_t start, size_t cnt,
+                           bool);
+static void loop_set_multiple (struct bitmap *, size_t start, size_t cnt,
+                               bool);
+static void verify (void);
+static void bench (void);
+
+/* Test the bitmap implementation. */
+void
+test (void)
+{
+  verify ();
+  bench ();
+  printf ("bitmap: PASS\n");
+}
+
+/* Compares the bitmap functions with the loops below on bitmaps
+   of every size up to MAX_SIZE, filled at random. */
+static void
+verify (void)
+{
+  size_t size;
+
+  printf ("testing various size bitmaps:");
+  for (size = 0; size < MAX_SIZE; size++)
+    {
+      struct bitmap *b = bitmap_create (size);
+      int repeat;
+      size_t i;
+
+      ASSERT (b != NULL);
+      if (size % 20 == 0)
+        printf (" %zu", size);
+      for (i = 0; i < size; i++)
+        bitmap_set (b, i, random_ulong () % 3 != 0);
+
+      for (repeat = 0; repeat < 30; repeat++)
+        {
+          size_t start = random_ulong () % (size + 1);
+          size_t cnt = random_ulong () % (size - start + 1);
+          size_t run = random_ulong () % 12;
+          bool value = random_ulong () % 2;
+
+          ASSERT (bitmap_count (b, start, cnt, value)
+                  == loop_count (b, start, cnt, value));
+          ASSERT (bitmap_contains (b, start, cnt, value)
+                  == loop_contains (b, start, cnt, value));
+          ASSERT (bitmap_scan (b, start, run, value)
+                  == loop_scan (b, start, run, value));
+
+          bitmap_set_multiple (b, start, cnt, value);
+          for (i = 0; i < cnt; i++)
+            ASSERT (bitmap_test (b, start + i) == value);
+        }
+      bitmap_destroy (b);
+    }
+  printf (" done\n");
+}
+
+/* Times the bitmap functions and the loops below on a bitmap
+   of BENCH_SIZE bits, all set except for a few near the end. */
+static void
+bench (void)
+{
+  struct bitmap *b = bitmap_create (BENCH_SIZE);
+  int64_t start;
+  int i;
+
+  ASSERT (b != NULL);
+  bitmap_set_all (b, true);
+  bitmap_set_multiple (b, BENCH_SIZE - 64, 8, false);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_REPEAT; i++)
+    ASSERT (bitmap_scan (b, 0, 8, false) == BENCH_SIZE - 64);
+  printf ("scan: %"PRId64" ticks, ", timer_elapsed (start));
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_REPEAT; i++)
+    ASSERT (loop_scan (b, 0, 8, false) == BENCH_SIZE - 64);
+  printf ("%"PRId64" ticks by bits\n", timer_elapsed (start));
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_REPEAT; i++)
+    ASSERT (bitmap_count (b, 0, BENCH_SIZE, false) == 8);
+  printf ("count: %"PRId64" ticks, ", timer_elapsed (start));
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_REPEAT; i++)
+    ASSERT (loop_count (b, 0, BENCH_SIZE, false) == 8);
+  printf ("%"PRId64" ticks by bits\n", timer_elapsed (start));
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_REPEAT; i++)
+    bitmap_set_multiple (b, 0, BENCH_SIZE - 64, i % 2 != 0);
+  printf ("set_multiple: %"PRId64" ticks, ", timer_elapsed (start));
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_REPEAT; i++)
+    loop_set_multiple (b, 0, BENCH_SIZE - 64, i % 2 != 0);
+  printf ("%"PRId64" ticks by bits\n", timer_elapsed (start));
+
+  bitmap_destroy (b);
+}
+
+/* Like bitmap_scan(), but tests one bit at a time. */
+static size_t
+loop_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  if (cnt <= bitmap_size (b))
+    {
+      size_t last = bitmap_size (b) - cnt;
+      size_t i;
+      for (i = start; i <= last; i++)
+        if (!loop_contains (b, i, cnt, !value))
+          return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Like bitmap_count(), but tests one bit at a time. */
+static size_t
+loop_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, value_cnt;
+
+  value_cnt = 0;
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      value_cnt++;
+  return value_cnt;
+}
+
+/* Like bitmap_contains(), but tests one bit at a time. */
+static bool
+loop_contains (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      return true;
+  return false;
+}
+
+/* Like bitmap_set_multiple(), but sets one bit at a time. */
+static void
+loop_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    bitmap_set (b, start + i, value);
+}
@@ -177,6 +177,11 @@ sub compare_output {
 			&& !/^ esi=.* edi=.* esp=.* ebp=.*/
 			&& !/^ cs=.* ds=.* es=.* ss=.*/, @output);
     }
+    my $ignore_stats = exists $options{IGNORE_STATS};
+    if ($ignore_stats) {
+	delete $options{IGNORE_STATS};
+	@output = grep (!/^\([a-zA-Z0-9-_]+\) stats: /, @output);
+    }
     die "unknown option " . (keys (%options))[0] . "\n" if %options;
 
     my ($msg);
@@ -224,6 +229,8 @@ sub compare_output {
       if $ignore_exit_codes;
     $msg .= "\n(User fault messages are excluded for matching purposes.)\n"
       if $ignore_user_faults;
+    $msg .= "\n(Benchmark statistics are excluded for matching purposes.)\n"
+      if $ignore_stats;
     fail "Test output failed to match any acceptable form.\n\n$msg";
 }
 
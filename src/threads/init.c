@@ -34,7 +34,9 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "filesys/fsutil.h"
 #endif
 
@@ -247,6 +249,16 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-layout"))
+        filesys_layout_name = value;
+      else if (!strcmp (name, "-alloc"))
+        free_map_alloc_name = value;
+      else if (!strcmp (name, "-cache"))
+        cache_capacity = atoi (value);
+      else if (!strcmp (name, "-cache-policy"))
+        cache_policy_name = value;
+      else if (!strcmp (name, "-cache-meta"))
+        cache_meta_percent = atoi (value);
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -312,6 +324,7 @@ run_actions (char **argv)
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
+      {"layout", 2, fsutil_layout},
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
@@ -360,6 +373,7 @@ usage (void)
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
+          "  layout FILE        Print how FILE and free space are laid out.\n"
           "  rm FILE            Delete FILE.\n"
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
@@ -373,6 +387,11 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -layout=NAME       Format with NAME inodes (blocks, extents).\n"
+          "  -alloc=NAME        Place new inodes by NAME (groups, next-fit).\n"
+          "  -cache=N           Use N sectors of buffer cache.\n"
+          "  -cache-policy=NAME Replace cache entries by NAME (2q, clock).\n"
+          "  -cache-meta=PCT    Keep PCT%% of the cache for metadata.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
@@ -336,3 +336,133 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW_LOCK.  A readers-writer lock can be held by
+   any number of readers at once, or by a single writer.  Like a
+   lock, it is not recursive: a thread holding it in either mode
+   must not try to acquire it again.
+
+   Waiting writers take precedence over new readers, so a steady
+   stream of readers cannot starve a writer. */
+void
+rw_lock_init (struct rw_lock *rw_lock)
+{
+  ASSERT (rw_lock != NULL);
+
+  lock_init (&rw_lock->lock);
+  cond_init (&rw_lock->can_read);
+  cond_init (&rw_lock->can_write);
+  rw_lock->reader_cnt = 0;
+  rw_lock->writer_cnt = 0;
+  rw_lock->writer = NULL;
+}
+
+/* Acquires RW_LOCK for reading, sleeping until no writer holds
+   it or is waiting for it. */
+void
+rw_lock_acquire_read (struct rw_lock *rw_lock)
+{
+  ASSERT (rw_lock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw_lock->lock);
+  while (rw_lock->writer != NULL || rw_lock->writer_cnt > 0)
+    cond_wait (&rw_lock->can_read, &rw_lock->lock);
+  rw_lock->reader_cnt++;
+  lock_release (&rw_lock->lock);
+}
+
+/* Tries to acquire RW_LOCK for reading and returns true if
+   successful or false on failure.  Does not wait for writers,
+   though it may sleep briefly on the internal lock. */
+bool
+rw_lock_try_acquire_read (struct rw_lock *rw_lock)
+{
+  bool success;
+
+  ASSERT (rw_lock != NULL);
+
+  lock_acquire (&rw_lock->lock);
+  success = rw_lock->writer == NULL && rw_lock->writer_cnt == 0;
+  if (success)
+    rw_lock->reader_cnt++;
+  lock_release (&rw_lock->lock);
+  return success;
+}
+
+/* Releases RW_LOCK, which the current thread holds for
+   reading. */
+void
+rw_lock_release_read (struct rw_lock *rw_lock)
+{
+  ASSERT (rw_lock != NULL);
+
+  lock_acquire (&rw_lock->lock);
+  ASSERT (rw_lock->reader_cnt > 0);
+  if (--rw_lock->reader_cnt == 0)
+    cond_signal (&rw_lock->can_write, &rw_lock->lock);
+  lock_release (&rw_lock->lock);
+}
+
+/* Acquires RW_LOCK for writing, sleeping until no other thread
+   holds it. */
+void
+rw_lock_acquire_write (struct rw_lock *rw_lock)
+{
+  ASSERT (rw_lock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw_lock->lock);
+  rw_lock->writer_cnt++;
+  while (rw_lock->writer != NULL || rw_lock->reader_cnt > 0)
+    cond_wait (&rw_lock->can_write, &rw_lock->lock);
+  rw_lock->writer_cnt--;
+  rw_lock->writer = thread_current ();
+  lock_release (&rw_lock->lock);
+}
+
+/* Tries to acquire RW_LOCK for writing and returns true if
+   successful or false on failure.  Does not wait for other
+   holders, though it may sleep briefly on the internal lock. */
+bool
+rw_lock_try_acquire_write (struct rw_lock *rw_lock)
+{
+  bool success;
+
+  ASSERT (rw_lock != NULL);
+
+  lock_acquire (&rw_lock->lock);
+  success = rw_lock->writer == NULL && rw_lock->reader_cnt == 0;
+  if (success)
+    rw_lock->writer = thread_current ();
+  lock_release (&rw_lock->lock);
+  return success;
+}
+
+/* Releases RW_LOCK, which the current thread holds for
+   writing.  Wakes a waiting writer if there is one, otherwise
+   all waiting readers. */
+void
+rw_lock_release_write (struct rw_lock *rw_lock)
+{
+  ASSERT (rw_lock != NULL);
+
+  lock_acquire (&rw_lock->lock);
+  ASSERT (rw_lock_held_for_write (rw_lock));
+  rw_lock->writer = NULL;
+  if (rw_lock->writer_cnt > 0)
+    cond_signal (&rw_lock->can_write, &rw_lock->lock);
+  else
+    cond_broadcast (&rw_lock->can_read, &rw_lock->lock);
+  lock_release (&rw_lock->lock);
+}
+
+/* Returns true if the current thread holds RW_LOCK for writing,
+   false otherwise. */
+bool
+rw_lock_held_for_write (const struct rw_lock *rw_lock)
+{
+  ASSERT (rw_lock != NULL);
+
+  return rw_lock->writer == thread_current ();
+}
@@ -41,6 +41,26 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rw_lock 
+  {
+    struct lock lock;           /* Protects the members below. */
+    struct condition can_read;  /* Signaled when readers may enter. */
+    struct condition can_write; /* Signaled when a writer may enter. */
+    unsigned reader_cnt;        /* Number of readers holding it. */
+    unsigned writer_cnt;        /* Number of writers waiting for it. */
+    struct thread *writer;      /* Thread holding it for writing. */
+  };
+
+void rw_lock_init (struct rw_lock *);
+void rw_lock_acquire_read (struct rw_lock *);
+bool rw_lock_try_acquire_read (struct rw_lock *);
+void rw_lock_release_read (struct rw_lock *);
+void rw_lock_acquire_write (struct rw_lock *);
+bool rw_lock_try_acquire_write (struct rw_lock *);
+void rw_lock_release_write (struct rw_lock *);
+bool rw_lock_held_for_write (const struct rw_lock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -2,17 +2,23 @@
 #include <stdio.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "filesys/cache.h"
+#include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "filesys/inode.h"
 
 /* The max length of a command line. */
 #define MAX_CMD_LEN 50
 
-/* The lock to be used in system call. */
+/* The lock to be used in system call.  Only exec takes it; the
+   file system does its own locking, so that file system calls
+   of different processes overlap. */
 struct lock syscall_critical_section;
 
 /* Function as the system call handler. */
@@ -47,6 +53,10 @@ bool syscall_mkdir (const char *dir);
 bool syscall_readdir (int fd, char *name);
 bool syscall_isdir (int fd);
 int syscall_inumber (int fd);
+bool syscall_fsync (int fd, bool data_only);
+bool syscall_fallocate (int fd, unsigned offset, unsigned length);
+void syscall_cache_stats (struct cache_stats *stats);
+int syscall_file_runs (int fd);
 
 /* Function to initialize the system call. */
 void
@@ -206,6 +216,38 @@ syscall_handler (struct intr_frame *f UNUSED){
       arg1 = *((int*)f->esp+1);
       f->eax = syscall_inumber((int)arg1);
       break;
+    case SYS_FSYNC:
+    case SYS_FDATASYNC:
+      /* Check validity of arguments. */
+      check_valid_pointer((void *)((int*)f->esp+1));
+      arg1 = *((int*)f->esp+1);
+      f->eax = syscall_fsync((int)arg1, *(int*) f->esp == SYS_FDATASYNC);
+      break;
+    case SYS_FALLOCATE:
+      /* Check validity of arguments. */
+      check_valid_pointer((void *)((int*)f->esp+1));
+      check_valid_pointer((void *)((int*)f->esp+2));
+      check_valid_pointer((void *)((int*)f->esp+3));
+      arg1 = *((int*)f->esp+1);
+      arg2 = *((int*)f->esp+2);
+      arg3 = *((int*)f->esp+3);
+      f->eax = syscall_fallocate((int)arg1, (unsigned int)arg2,
+                                 (unsigned int)arg3);
+      break;
+    case SYS_CACHE_STATS:
+      /* Check validity of arguments. */
+      check_valid_pointer((void *)((int*)f->esp+1));
+      arg1 = *((int*)f->esp+1);
+      check_valid_pointer((void*)arg1);
+      check_pointer((void*)arg1, sizeof (struct cache_stats));
+      syscall_cache_stats((struct cache_stats*)arg1);
+      break;
+    case SYS_FILE_RUNS:
+      /* Check validity of arguments. */
+      check_valid_pointer((void *)((int*)f->esp+1));
+      arg1 = *((int*)f->esp+1);
+      f->eax = syscall_file_runs((int)arg1);
+      break;
     default:
       syscall_exit(-1);
   }
@@ -301,9 +343,7 @@ syscall_wait (int pid){
    return value returned by filesys_create. */
 bool 
 syscall_create (const char *file, unsigned initial_size){
-  lock_acquire(&syscall_critical_section);
   bool ret_value = filesys_create(file, initial_size);
-  lock_release(&syscall_critical_section);
   return ret_value;
 }
 
@@ -313,9 +353,7 @@ syscall_create (const char *file, unsigned initial_size){
    in file system, return its return value. */
 bool 
 syscall_remove (const char *file){
-  lock_acquire(&syscall_critical_section);
   bool ret_value = filesys_remove(file);
-  lock_release(&syscall_critical_section);
   return ret_value;
 }
 
@@ -325,11 +363,9 @@ syscall_remove (const char *file){
    Return -1 if fails to open the file. */
 int 
 syscall_open (const char *file){
-  lock_acquire(&syscall_critical_section);
   struct file *new_file_open = filesys_open(file);
   /* If failed to open the file, then return -1 as error. */
   if (!new_file_open){
-    lock_release(&syscall_critical_section);
     return -1;
   }
   /* allocate space for the new entry */
@@ -351,7 +387,6 @@ syscall_open (const char *file){
     new_item->dir = dir_open(inode_open);
 
   list_push_back(&thread_current()->files_per_process, &new_item->elem);
-  lock_release(&syscall_critical_section);
   return ret_value;
 }
 
@@ -361,15 +396,12 @@ syscall_open (const char *file){
    call the function of file_length and return. */
 int 
 syscall_filesize (int fd){  
-  lock_acquire(&syscall_critical_section);
   struct file *current_file = fd_to_file(fd);
   if (!current_file){
     /* If givn fd of current thread is empty */
-    lock_release(&syscall_critical_section);
     return -1;
   }
   int ret_value = (int)file_length(current_file);
-  lock_release(&syscall_critical_section);
   return ret_value;
 }
 
@@ -386,15 +418,12 @@ syscall_read (int fd, void *buffer, unsigned size){
   /* If fd == 1, then return 0 immediately. */
   if (fd == 1)
     return 0;
-  lock_acquire(&syscall_critical_section);
   struct file *current_file = fd_to_file(fd);
   if (!current_file){
     /* If givn fd of current thread is empty */
-    lock_release(&syscall_critical_section);
     return -1;
   }
   int ret_value = (int)file_read(current_file, buffer, size);
-  lock_release(&syscall_critical_section);
   return ret_value;
 }
 
@@ -412,15 +441,12 @@ syscall_write (int fd, const void *buffer, unsigned size){
   /* If fd == 0, then return 0. */
   if (fd == 0)
     return 0;
-  lock_acquire(&syscall_critical_section);
   struct file *current_file = fd_to_file(fd);
   if (!current_file){
     /* If givn fd of current thread is empty */
-    lock_release(&syscall_critical_section);
     return -1;
   }
   int ret_value = (int)file_write(current_file, buffer, size);
-  lock_release(&syscall_critical_section);
   return ret_value;
 }
 
@@ -430,15 +456,12 @@ syscall_write (int fd, const void *buffer, unsigned size){
    in bytes from the beginning of the file. */
 void
 syscall_seek (int fd, unsigned position){
-  lock_acquire(&syscall_critical_section);
   struct file *current_file = fd_to_file(fd);
   if (!current_file){
     /* If givn fd of current thread is empty */
-    lock_release(&syscall_critical_section);
     return;
   }
   file_seek(current_file, position);
-  lock_release(&syscall_critical_section);
   return;
 }
 
@@ -448,15 +471,12 @@ syscall_seek (int fd, unsigned position){
    in bytes from the beginning of the file. */
 unsigned 
 syscall_tell (int fd){
-  lock_acquire(&syscall_critical_section);
   struct file *current_file = fd_to_file(fd);
   if (!current_file){
     /* If givn fd of current thread is empty */
-    lock_release(&syscall_critical_section);
     return;
   }
   unsigned ret_value = (unsigned)file_tell(current_file);
-  lock_release(&syscall_critical_section);
   return ret_value;
 }
 
@@ -466,11 +486,9 @@ syscall_tell (int fd){
    as if by calling this function for each one. */
 void 
 syscall_close (int fd){
-  lock_acquire(&syscall_critical_section);
   struct file *current_file = fd_to_file(fd);
   if (!current_file){
     /* If givn fd of current thread is empty */
-    lock_release(&syscall_critical_section);
     return -1;
   }
   /* find the file struct by the current file, for dir information. */
@@ -482,7 +500,6 @@ syscall_close (int fd){
   /* close the current file and remove it from the list. */
   file_close(current_file);
   list_remove(&pf->elem);
-  lock_release(&syscall_critical_section);
 }
 
 
@@ -491,12 +508,10 @@ syscall_close (int fd){
    successful, false on failure. */
 bool
 syscall_chdir(const char *dir){
-  lock_acquire(&syscall_critical_section);
   if (dir[0] == '/'){
     /* if the dir is root directory, change cwd to root. */
     if (!thread_current()->cwd)
       thread_current()->cwd = dir_open_root();
-    lock_release(&syscall_critical_section);
     return true;
   }
   /* get the current working directory of the current thread. */
@@ -511,14 +526,12 @@ syscall_chdir(const char *dir){
   struct inode *inode;
   if (!dir_lookup(temp_dir, dir, &inode)){
     /* If cannot find, release lock and return. */
-    lock_release(&syscall_critical_section);
     return false;
   }
   /* If find, close the directory and set the cwd into the 
      directory of the inode for the file. */
   dir_close(temp_dir);
   thread_current()->cwd = dir_open(inode);
-  lock_release(&syscall_critical_section);
   if (temp_dir)
     return true;
   return false;
@@ -533,15 +546,14 @@ syscall_chdir(const char *dir){
    /a/b/c does not. */
 bool
 syscall_mkdir(const char *dir){
-  lock_acquire(&syscall_critical_section);
   block_sector_t sector;
-  if(!free_map_allocate(1, &sector)){
-    lock_release(&syscall_critical_section);
-    return false;
-  }
+  struct dir *get_dir = NULL;
+  bool ret_value = false;
   /* find the last elem of the string, e.g. for string "/a/b/c", "c" will 
      be the curr_val. */
   char *copy_path = (char *)malloc(sizeof(char) * (strlen(dir) + 1));
+  if (copy_path == NULL)
+    return false;
   memcpy(copy_path, dir, strlen(dir) + 1);
   char *save_ptr;
   char *curr_val = "";
@@ -552,15 +564,30 @@ syscall_mkdir(const char *dir){
   }
   /* find the last elem of the directory, e.g. for path "/a/b/c", c will 
      be the leaf. */
-  struct dir *get_dir = find_leaf(dir);
-  // block_sector_t sector;
-  bool ret_value = dir_create(sector, 1, get_dir);
+  get_dir = find_leaf((char *) dir);
+  if (get_dir == NULL)
+    goto done;
+  /* The new directory's inode is placed by its parent's. */
+  if(!free_map_allocate_inode(inode_get_inumber(dir_get_inode(get_dir)),
+                              true, &sector))
+    goto done;
+  if (!dir_create(sector, 1, get_dir)){
+    free_map_release(sector, 1);
+    goto done;
+  }
   /* Adds a file named curr_val to get_dir. The file's inode is in sector
-   sector. */
-  if (!dir_add (get_dir, curr_val, sector))
-    /* Return false on add failure. */
-    ret_value = false;
-  lock_release(&syscall_critical_section);
+   sector.  On failure, frees the new directory again, its sector and
+   its blocks, without opening it, which could fail for want of
+   memory. */
+  if (!dir_add (get_dir, curr_val, sector)){
+    inode_release(sector);
+    goto done;
+  }
+  ret_value = true;
+
+ done:
+  dir_close(get_dir);
+  free(copy_path);
   return ret_value;
 }
 
@@ -572,17 +599,14 @@ syscall_mkdir(const char *dir){
    returns false. */
 bool
 syscall_readdir(int fd, char *name){
-  lock_acquire(&syscall_critical_section);
   struct file *current_file = fd_to_file(fd);
   if (!current_file){
     /* If givn fd of current thread is empty */
-    lock_release(&syscall_critical_section);
     return false;
   }
   /* If successful, stores the null-terminated file name in name. */
   struct dir *current_dir = file_to_dir(current_file);
   bool ret_value = dir_readdir(current_dir, name);
-  lock_release(&syscall_critical_section);
   /* Return true if successful, otherwise return false. */
   return ret_value;
 }
@@ -592,17 +616,14 @@ syscall_readdir(int fd, char *name){
 false if it represents an ordinary file. */
 bool
 syscall_isdir(int fd){
-  lock_acquire(&syscall_critical_section);
   struct file *current_file = fd_to_file(fd);
   if (!current_file){
     /* If givn fd of current thread is empty */
-    lock_release(&syscall_critical_section);
     return false;
   }
   /* get the type(directory or ordinary) of the inode/file and return. */
   struct inode *inode = file_get_inode(current_file);
   bool ret_value = inode->data.dir_or_file;
-  lock_release(&syscall_critical_section);
   return ret_value;
 }
 
@@ -611,21 +632,70 @@ syscall_isdir(int fd){
    which may represent an ordinary file or a directory. */
 int
 syscall_inumber(int fd){
-  lock_acquire(&syscall_critical_section);
   struct file *current_file = fd_to_file(fd);
   if (!current_file){
     /* If givn fd of current thread is empty */
-    lock_release(&syscall_critical_section);
     return -1;
   }
   /* get the inode number of the inode/file and return. */
   struct inode *inode = file_get_inode(current_file);
   int ret_value = inode_get_inumber(inode);
-  lock_release(&syscall_critical_section);
   return ret_value;
 }
 
 
+/* Writes the file or directory associated with fd back to
+   disk, with its inode unless DATA_ONLY. Returns false if
+   fd is not open. */
+bool
+syscall_fsync(int fd, bool data_only){
+  struct file *current_file = fd_to_file(fd);
+  if (!current_file){
+    /* If givn fd of current thread is empty */
+    return false;
+  }
+  file_sync(current_file, data_only);
+  return true;
+}
+
+
+/* Reserves space for LENGTH bytes of the file associated with
+   fd starting at OFFSET, without writing them, growing the file
+   if needed. Returns false if fd is not open or the space
+   cannot be reserved. */
+bool
+syscall_fallocate(int fd, unsigned offset, unsigned length){
+  struct file *current_file = fd_to_file(fd);
+  if (!current_file)
+    /* If givn fd of current thread is empty */
+    return false;
+  return file_allocate(current_file, offset, length);
+}
+
+
+/* Copies the counters of the buffer cache into STATS,
+   so a program can diff them around a workload. */
+void
+syscall_cache_stats(struct cache_stats *stats){
+  cache_get_stats(stats);
+}
+
+
+/* Returns the number of runs of consecutive sectors that the
+   data of the file associated with fd takes on disk, counting
+   reserved sectors but not holes, or -1 if fd is not open. */
+int
+syscall_file_runs(int fd){
+  struct file *current_file = fd_to_file(fd);
+  size_t sector_cnt, run_cnt;
+  if (!current_file)
+    /* If givn fd of current thread is empty */
+    return -1;
+  inode_count_runs(file_get_inode(current_file), &sector_cnt, &run_cnt);
+  return run_cnt;
+}
+
+
 // proj4 helper functions
 /* Find the file given fd from the struct file_struct. */
 struct file* fd_to_file(int fd){